@@ -0,0 +1,18 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    AllocationCounter.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __AllocationCounter_h_
+#define __AllocationCounter_h_
+
+#include <cstdint>
+
+// Allocations made through the global operator new since the program
+// started, on every thread. Linking AllocationCounter.cpp replaces
+// operator new and delete for the whole program, so it belongs in the
+// application only. Ogre's own allocator, when it is built with one,
+// isn't counted.
+std::uint64_t allocationCount();
+
+#endif // #ifndef __AllocationCounter_h_
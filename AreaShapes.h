@@ -0,0 +1,75 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    AreaShapes.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __AreaShapes_h_
+#define __AreaShapes_h_
+
+#include "GridMath.h"
+
+#include <cstdint>
+
+// The shapes of area an AreaTemplate can be built for. Each is a policy
+// with static members only, so the template that uses it is compiled
+// separately for every shape and the tests below inline into it.
+//
+// A template is grown outwards from its origin. Each step of the walk is
+// one of the 26 grid directions and is taken if step(s, dir) allows it;
+// the cell it lands on is kept if includes(offset, radius) holds. All of
+// them measure reach with distance3, so their sizes are in the same units.
+//
+// DIRECTED shapes have a template per grid direction. The others have a
+// single template, facing {0, 0, 0}. Directed shapes must be symmetric
+// under every cube symmetry that keeps their direction, since only the
+// face, edge and corner templates are ever built.
+
+// Is the angle between a and b at most 45 degrees? Done on integers so the
+// cases sitting exactly on 45 degrees are always included.
+inline bool within45(const GridCell &a, const GridCell &b) {
+    std::int64_t dot = std::int64_t(a.x) * b.x + std::int64_t(a.y) * b.y + std::int64_t(a.z) * b.z;
+    std::int64_t la = std::int64_t(a.x) * a.x + std::int64_t(a.y) * a.y + std::int64_t(a.z) * a.z;
+    std::int64_t lb = std::int64_t(b.x) * b.x + std::int64_t(b.y) * b.y + std::int64_t(b.z) * b.z;
+    return dot > 0 && 2 * dot * dot >= la * lb;
+}
+
+// Cells reached by steps within 45 degrees of dir
+struct ConeShape
+{
+    static const bool DIRECTED = true;
+
+    static bool step(const GridCell &s, const GridCell &dir) { return within45(s, dir); }
+    static bool includes(const GridCell &offset, int radius) { return distance3(offset) <= radius; }
+};
+
+// Every cell within radius of the origin: bursts and emanations
+struct BurstShape
+{
+    static const bool DIRECTED = false;
+
+    static bool step(const GridCell &, const GridCell &) { return true; }
+    static bool includes(const GridCell &offset, int radius) { return distance3(offset) <= radius; }
+};
+
+// A one cell wide line running radius cells along dir
+struct LineShape
+{
+    static const bool DIRECTED = true;
+
+    static bool step(const GridCell &s, const GridCell &dir) { return s == dir; }
+    static bool includes(const GridCell &offset, int radius) { return distance3(offset) <= radius; }
+};
+
+// An upright cylinder of the given radius on the floor plane, reaching
+// radius cells above and below the origin
+struct CylinderShape
+{
+    static const bool DIRECTED = false;
+
+    static bool step(const GridCell &, const GridCell &) { return true; }
+    static bool includes(const GridCell &offset, int radius) {
+        return std::abs(offset.y) <= radius && distance3(offset.x, 0, offset.z) <= radius;
+    }
+};
+
+#endif // #ifndef __AreaShapes_h_
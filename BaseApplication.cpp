@@ -16,6 +16,9 @@ This source file is part of the
 */
 #include "BaseApplication.h"
 
+// Seconds between refreshes of the details panel
+static const Ogre::Real DETAILS_INTERVAL = 0.25f;
+
 //-------------------------------------------------------------------------------------
 BaseApplication::BaseApplication(void)
     : mRoot(0),
@@ -27,8 +30,15 @@ BaseApplication::BaseApplication(void)
     mTrayMgr(0),
     mCameraMan(0),
     mDetailsPanel(0),
+    mDetailsAge(0),
     mCursorWasVisible(false),
     mShutDown(false),
+    mResourceTicket(0),
+    mResourcesRequested(false),
+    mResourcesLoaded(false),
+    mResourceProgress(0),
+    mScriptsTotal(0),
+    mScriptsParsed(0),
     mInputManager(0),
     mMouse(0),
     mKeyboard(0)
@@ -44,6 +54,7 @@ BaseApplication::~BaseApplication(void)
     //Remove ourself as a Window listener
     Ogre::WindowEventUtilities::removeWindowEventListener(mWindow, this);
     windowClosed(mWindow);
+    if (mRoot) Ogre::ResourceGroupManager::getSingleton().removeResourceGroupListener(this);
     delete mRoot;
 }
 
@@ -142,12 +153,16 @@ void BaseApplication::createFrameListener(void)
     items.push_back("");
     items.push_back("Filtering");
     items.push_back("Poly Mode");
+    addDetails(items);
 
     mDetailsPanel = mTrayMgr->createParamsPanel(OgreBites::TL_NONE, "DetailsPanel", 200, items);
     mDetailsPanel->setParamValue(9, "Bilinear");
     mDetailsPanel->setParamValue(10, "Solid");
     mDetailsPanel->hide();
 
+    mResourceProgress = mTrayMgr->createProgressBar(OgreBites::TL_CENTER, "ResourceProgress",
+                                                    "Loading resources", 300, 180);
+
     mRoot->addFrameListener(this);
 }
 //-------------------------------------------------------------------------------------
@@ -193,12 +208,70 @@ void BaseApplication::setupResources(void)
 //-------------------------------------------------------------------------------------
 void BaseApplication::createResourceListener(void)
 {
-
+    Ogre::ResourceGroupManager::getSingleton().addResourceGroupListener(this);
 }
 //-------------------------------------------------------------------------------------
 void BaseApplication::loadResources(void)
 {
-    Ogre::ResourceGroupManager::getSingleton().initialiseAllResourceGroups();
+    // Only what the trays need up front, the rest comes in the background
+    // once the first frame is up. Groups are only initialised, so meshes and
+    // textures are still loaded the first time they are used.
+    Ogre::ResourceGroupManager::getSingleton().initialiseResourceGroup("Essential");
+}
+//-------------------------------------------------------------------------------------
+void BaseApplication::loadBackgroundResources(void)
+{
+    // Runs on a worker thread when Ogre is built with thread support, and
+    // right away otherwise
+    mResourceTicket = Ogre::ResourceBackgroundQueue::getSingleton().initialiseResourceGroup(
+                Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+    mResourcesRequested = true;
+}
+//-------------------------------------------------------------------------------------
+void BaseApplication::backgroundResourcesLoaded(void)
+{
+}
+//-------------------------------------------------------------------------------------
+void BaseApplication::resourceGroupScriptingStarted(const Ogre::String& groupName, size_t scriptCount)
+{
+    mScriptsTotal += scriptCount;
+}
+
+void BaseApplication::scriptParseStarted(const Ogre::String& scriptName, bool& skipThisScript)
+{
+}
+
+void BaseApplication::scriptParseEnded(const Ogre::String& scriptName, bool skipped)
+{
+    mScriptsParsed++;
+}
+
+void BaseApplication::resourceGroupScriptingEnded(const Ogre::String& groupName)
+{
+}
+
+void BaseApplication::resourceGroupLoadStarted(const Ogre::String& groupName, size_t resourceCount)
+{
+}
+
+void BaseApplication::resourceLoadStarted(const Ogre::ResourcePtr& resource)
+{
+}
+
+void BaseApplication::resourceLoadEnded(void)
+{
+}
+
+void BaseApplication::worldGeometryStageStarted(const Ogre::String& description)
+{
+}
+
+void BaseApplication::worldGeometryStageEnded(void)
+{
+}
+
+void BaseApplication::resourceGroupLoadEnded(const Ogre::String& groupName)
+{
 }
 //-------------------------------------------------------------------------------------
 void BaseApplication::go(void)
@@ -249,8 +322,17 @@ bool BaseApplication::setup(void)
     return true;
 }
 //-------------------------------------------------------------------------------------
+bool BaseApplication::frameStarted(const Ogre::FrameEvent& evt)
+{
+    mFrameStarted = FrameTrace::Clock::now();
+    return true;
+}
+//-------------------------------------------------------------------------------------
 bool BaseApplication::frameRenderingQueued(const Ogre::FrameEvent& evt)
 {
+    // Ogre has just queued up the scene for rendering
+    FrameTrace::instance().record("render", mFrameStarted, FrameTrace::Clock::now());
+
     if(mWindow->isClosed())
         return false;
 
@@ -258,26 +340,88 @@ bool BaseApplication::frameRenderingQueued(const Ogre::FrameEvent& evt)
         return false;
 
     //Need to capture/update each device
-    mKeyboard->capture();
-    mMouse->capture();
+    {
+        TraceScope scope("input.keyboard");
+        mKeyboard->capture();
+    }
+    {
+        TraceScope scope("input.mouse");
+        mMouse->capture();
+    }
+
+    {
+        TraceScope scope("trays");
+        mTrayMgr->frameRenderingQueued(evt);
+    }
 
-    mTrayMgr->frameRenderingQueued(evt);
+    if (mResourcesRequested && !mResourcesLoaded)
+    {
+        if (Ogre::ResourceBackgroundQueue::getSingleton().isProcessComplete(mResourceTicket))
+        {
+            mTrayMgr->destroyWidget(mResourceProgress);
+            mResourceProgress = 0;
+            mResourcesLoaded = true;
+            backgroundResourcesLoaded();
+        }
+        else
+        {
+            size_t total = mScriptsTotal, parsed = mScriptsParsed;
+            mResourceProgress->setComment(Ogre::StringConverter::toString(parsed) + " / " +
+                                          Ogre::StringConverter::toString(total) + " scripts");
+            mResourceProgress->setProgress(total ? Ogre::Real(parsed) / total : 0);
+        }
+    }
 
     if (!mTrayMgr->isDialogVisible())
     {
-        mCameraMan->frameRenderingQueued(evt);   // if dialog isn't up, then update the camera
-        if (mDetailsPanel->isVisible())   // if details panel is visible, then update its contents
         {
-            mDetailsPanel->setParamValue(0, Ogre::StringConverter::toString(mCamera->getDerivedPosition().x));
-            mDetailsPanel->setParamValue(1, Ogre::StringConverter::toString(mCamera->getDerivedPosition().y));
-            mDetailsPanel->setParamValue(2, Ogre::StringConverter::toString(mCamera->getDerivedPosition().z));
-            mDetailsPanel->setParamValue(4, Ogre::StringConverter::toString(mCamera->getDerivedOrientation().w));
-            mDetailsPanel->setParamValue(5, Ogre::StringConverter::toString(mCamera->getDerivedOrientation().x));
-            mDetailsPanel->setParamValue(6, Ogre::StringConverter::toString(mCamera->getDerivedOrientation().y));
-            mDetailsPanel->setParamValue(7, Ogre::StringConverter::toString(mCamera->getDerivedOrientation().z));
+            TraceScope scope("camera");
+            mCameraMan->frameRenderingQueued(evt);   // if dialog isn't up, then update the camera
+        }
+        // if details panel is visible, then update its contents, a few
+        // times a second so that formatting them costs next to nothing
+        mDetailsAge += evt.timeSinceLastFrame;
+        if (mDetailsPanel->isVisible() && mDetailsAge >= DETAILS_INTERVAL)
+        {
+            TraceScope scope("details");
+            updateDetails();
+            mDetailsAge = 0;
         }
     }
 
+    frameWorkDone();
+    return true;
+}
+//-------------------------------------------------------------------------------------
+void BaseApplication::frameWorkDone(void)
+{
+    mRenderingQueued = FrameTrace::Clock::now();
+}
+//-------------------------------------------------------------------------------------
+void BaseApplication::addDetails(Ogre::StringVector& items)
+{
+}
+//-------------------------------------------------------------------------------------
+void BaseApplication::updateDetails(void)
+{
+    mDetailsPanel->setParamValue(0, Ogre::StringConverter::toString(mCamera->getDerivedPosition().x));
+    mDetailsPanel->setParamValue(1, Ogre::StringConverter::toString(mCamera->getDerivedPosition().y));
+    mDetailsPanel->setParamValue(2, Ogre::StringConverter::toString(mCamera->getDerivedPosition().z));
+    mDetailsPanel->setParamValue(4, Ogre::StringConverter::toString(mCamera->getDerivedOrientation().w));
+    mDetailsPanel->setParamValue(5, Ogre::StringConverter::toString(mCamera->getDerivedOrientation().x));
+    mDetailsPanel->setParamValue(6, Ogre::StringConverter::toString(mCamera->getDerivedOrientation().y));
+    mDetailsPanel->setParamValue(7, Ogre::StringConverter::toString(mCamera->getDerivedOrientation().z));
+}
+//-------------------------------------------------------------------------------------
+bool BaseApplication::frameEnded(const Ogre::FrameEvent& evt)
+{
+    // the rest of the render, up to and including the buffer swap, from
+    // the end of the frame's own work
+    FrameTrace::instance().record("present", mRenderingQueued, FrameTrace::Clock::now());
+
+    // the first frame is on screen, so start on the rest of the resources
+    if (!mResourcesRequested)
+        loadBackgroundResources();
     return true;
 }
 //-------------------------------------------------------------------------------------
@@ -362,6 +506,19 @@ bool BaseApplication::keyPressed( const OIS::KeyEvent &arg )
     {
         Ogre::TextureManager::getSingleton().reloadAll();
     }
+    else if (arg.key == OIS::KC_P)   // start or stop recording a frame trace
+    {
+        FrameTrace &trace = FrameTrace::instance();
+        trace.setEnabled(!trace.enabled());
+        if (!trace.enabled())
+        {
+            const Ogre::String path = "frames.trace.json";
+            if (trace.write(path))
+                Ogre::LogManager::getSingleton().logMessage("Frame trace written to " + path);
+            else
+                Ogre::LogManager::getSingleton().logMessage("Could not write frame trace to " + path);
+        }
+    }
     else if (arg.key == OIS::KC_SYSRQ)   // take a screenshot
     {
         mWindow->writeContentsToTimestampedFile("screenshot", ".jpg");
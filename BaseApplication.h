@@ -25,6 +25,7 @@ This source file is part of the
 #include <OgreSceneManager.h>
 #include <OgreRenderWindow.h>
 #include <OgreConfigFile.h>
+#include <OgreResourceBackgroundQueue.h>
 
 #include <OISEvents.h>
 #include <OISInputManager.h>
@@ -34,7 +35,11 @@ This source file is part of the
 #include <SdkTrays.h>
 #include <SdkCameraMan.h>
 
-class BaseApplication : public Ogre::FrameListener, public Ogre::WindowEventListener, public OIS::KeyListener, public OIS::MouseListener, OgreBites::SdkTrayListener
+#include "FrameTrace.h"
+
+#include <atomic>
+
+class BaseApplication : public Ogre::FrameListener, public Ogre::WindowEventListener, public Ogre::ResourceGroupListener, public OIS::KeyListener, public OIS::MouseListener, OgreBites::SdkTrayListener
 {
 public:
     BaseApplication(void);
@@ -54,9 +59,34 @@ protected:
     virtual void setupResources(void);
     virtual void createResourceListener(void);
     virtual void loadResources(void);
+    virtual void loadBackgroundResources(void);
+    // Called on the main thread once the background resources are in
+    virtual void backgroundResourcesLoaded(void);
+    // Appends the names of any entries of their own to the details panel
+    virtual void addDetails(Ogre::StringVector& items);
+    // Fills in the details panel, a few times a second while it is shown
+    virtual void updateDetails(void);
+    // Ends the frame's own work, so FrameTrace counts the rest of the frame
+    // as present. Subclasses that do more after frameRenderingQueued()
+    // call it again once they are done.
+    void frameWorkDone(void);
 
     // Ogre::FrameListener
+    virtual bool frameStarted(const Ogre::FrameEvent& evt);
     virtual bool frameRenderingQueued(const Ogre::FrameEvent& evt);
+    virtual bool frameEnded(const Ogre::FrameEvent& evt);
+
+    // Ogre::ResourceGroupListener, may be called from the loading thread
+    virtual void resourceGroupScriptingStarted(const Ogre::String& groupName, size_t scriptCount);
+    virtual void scriptParseStarted(const Ogre::String& scriptName, bool& skipThisScript);
+    virtual void scriptParseEnded(const Ogre::String& scriptName, bool skipped);
+    virtual void resourceGroupScriptingEnded(const Ogre::String& groupName);
+    virtual void resourceGroupLoadStarted(const Ogre::String& groupName, size_t resourceCount);
+    virtual void resourceLoadStarted(const Ogre::ResourcePtr& resource);
+    virtual void resourceLoadEnded(void);
+    virtual void worldGeometryStageStarted(const Ogre::String& description);
+    virtual void worldGeometryStageEnded(void);
+    virtual void resourceGroupLoadEnded(const Ogre::String& groupName);
 
     // OIS::KeyListener
     virtual bool keyPressed( const OIS::KeyEvent &arg );
@@ -83,9 +113,22 @@ protected:
     OgreBites::SdkTrayManager* mTrayMgr;
     OgreBites::SdkCameraMan* mCameraMan;       // basic camera controller
     OgreBites::ParamsPanel* mDetailsPanel;     // sample details panel
+    Ogre::Real mDetailsAge;                    // seconds since the details were filled in
     bool mCursorWasVisible;                    // was cursor visible before dialog appeared
     bool mShutDown;
 
+    // background loading of the General resource group
+    Ogre::BackgroundProcessTicket mResourceTicket;
+    bool mResourcesRequested;
+    bool mResourcesLoaded;
+    OgreBites::ProgressBar* mResourceProgress;
+    std::atomic<size_t> mScriptsTotal;
+    std::atomic<size_t> mScriptsParsed;
+
+    // frame stage boundaries for FrameTrace
+    FrameTrace::Clock::time_point mFrameStarted;
+    FrameTrace::Clock::time_point mRenderingQueued;
+
     //OIS Input devices
     OIS::InputManager* mInputManager;
     OIS::Mouse*    mMouse;
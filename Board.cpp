@@ -0,0 +1,159 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    Board.cpp
+-----------------------------------------------------------------------------
+*/
+#include "Board.h"
+#include "FrameTrace.h"
+
+//-------------------------------------------------------------------------------------
+Board::Board(std::size_t radii)
+    : m_ogres(CHUNK_SHIFT),
+      m_party(CHUNK_SHIFT),
+      m_shadowTables(radii),
+      m_lineOfEffectDirty(true),
+      m_coverageDirty(true)
+{
+}
+
+void Board::clear()
+{
+    m_ogres.clear();
+    m_party.clear();
+    m_occupied.clear();
+    m_ogreCells.clear();
+    m_walls.clear();
+    m_lineOfEffectDirty = true;
+    m_coverageDirty = true;
+}
+
+bool Board::addCreature(const GridCell &cell, CreatureType type)
+{
+    // one creature to a cell, and none inside a wall
+    if (m_occupied.test(cell) || m_walls.test(cell)) {
+        return false;
+    }
+    m_occupied.set(cell);
+    if (type == AllyCreature) {
+        m_party.insert(cell);
+        return true;
+    }
+
+    m_ogres.insert(cell);
+    m_ogreCells.set(cell);
+    if (!m_coverageDirty && !m_lineOfEffectDirty) {
+        const GridCell offset = cell - m_coverage->origin();
+        if (m_lineOfEffect->visible(offset)) {
+            m_coverage->add(offset);
+        }
+    }
+    return true;
+}
+
+bool Board::addWall(const GridCell &cell, bool &conesChanged)
+{
+    conesChanged = false;
+    if (m_occupied.test(cell) || m_walls.test(cell)) {
+        return false;
+    }
+    m_walls.set(cell);
+    conesChanged = wallChanged(cell, true);
+    return true;
+}
+
+bool Board::removeWall(const GridCell &cell, bool &conesChanged)
+{
+    conesChanged = false;
+    if (!m_walls.test(cell)) {
+        return false;
+    }
+    m_walls.reset(cell);
+    conesChanged = wallChanged(cell, false);
+    return true;
+}
+
+// Brings the line of effect up to date after one wall changed, which only
+// touches the cells in that wall's shadow, and counts the trolls in those
+// cells in or out of the cone coverage. The cones only need evaluating
+// again if a cone covers one of the cells that changed.
+bool Board::wallChanged(const GridCell &cell, bool added)
+{
+    if (!m_lineOfEffect || m_lineOfEffectDirty) {
+        // recomputed in full when next needed
+        return false;
+    }
+
+    TraceScope scope("walls.lineOfEffect");
+    std::uint32_t affected = 0;
+    ConeCoverage *coverage = m_coverageDirty ? nullptr : m_coverage.get();
+    const ConeSet *cones = m_coverage ? &m_coverage->areas() : nullptr;
+    const OccupancyGrid &ogreCells = m_ogreCells;
+    const GridCell origin = m_lineOfEffect->origin();
+    auto flipped = [&, cones, coverage](const GridCell &offset) {
+        affected |= cones ? cones->directionsContaining(offset) : 1;
+        if (coverage && ogreCells.test(origin + offset)) {
+            if (added) {
+                coverage->remove(offset);
+            } else {
+                coverage->add(offset);
+            }
+        }
+    };
+    if (added) {
+        m_lineOfEffect->addWall(cell, flipped);
+    } else {
+        m_lineOfEffect->removeWall(cell, flipped);
+    }
+    return affected != 0;
+}
+
+std::uint32_t Board::evaluate(const std::shared_ptr<const ConeSet> &cones, const GridCell &origin)
+{
+    // Walls only cost a full recompute when the origin moves or the radius
+    // changes; see wallChanged() for the rest
+    if (!m_lineOfEffect || m_lineOfEffect->radius() != cones->radius()) {
+        m_lineOfEffect.reset(new LineOfEffect(m_shadowTables.get(cones->radius())));
+        m_lineOfEffectDirty = true;
+    }
+    if (!m_coverage || &m_coverage->areas() != cones.get()) {
+        m_coverage.reset(new ConeCoverage(cones));
+        m_coverageDirty = true;
+    }
+    const bool clearBefore = !m_lineOfEffectDirty && m_lineOfEffect->wallCount() == 0;
+    if (m_lineOfEffectDirty || m_lineOfEffect->origin() != origin) {
+        TraceScope scope("mouse.lineOfEffect");
+        m_lineOfEffect->reset(origin, m_walls);
+        m_lineOfEffectDirty = false;
+    }
+
+    // The counts follow the origin a cell at a time, as long as no wall is
+    // in reach of either end of the step and there are enough trolls
+    // nearby that counting them all again would cost more
+    if (!m_coverageDirty && m_coverage->origin() != origin) {
+        const bool stepped = clearBefore && m_lineOfEffect->wallCount() == 0 &&
+                             m_coverage->stepCost() < m_coverage->reach() &&
+                             m_coverage->step(origin, m_ogreCells);
+        m_coverageDirty = !stepped;
+    }
+    if (m_coverageDirty) {
+        TraceScope scope("mouse.coverage");
+        m_coverage->reset(m_ogres, *m_lineOfEffect);
+        m_coverageDirty = false;
+    }
+
+    return m_coverage->coveringAll(m_ogres.size());
+}
+
+std::vector<ConePlacement> Board::solve(const ConeSet &cones, std::size_t count)
+{
+    // Every floor grid point within reach of a troll is a candidate origin
+    GridCell lo, hi;
+    if (!m_ogres.bounds(lo, hi)) {
+        return std::vector<ConePlacement>();
+    }
+    const int radius = cones.radius();
+    return findBestCones(cones, m_ogres, m_party,
+                         GridCell(lo.x - radius, 0, lo.z - radius),
+                         GridCell(hi.x + radius, 0, hi.z + radius),
+                         count, m_shadowTables.get(radius), m_walls);
+}
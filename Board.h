@@ -0,0 +1,82 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    Board.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __Board_h_
+#define __Board_h_
+
+#include "ConeCoverage.h"
+#include "ConeSolver.h"
+#include "EncounterFile.h"
+#include "LineOfEffect.h"
+#include "OccupancyGrid.h"
+#include "SpatialHash.h"
+
+#include <memory>
+#include <vector>
+
+// The creatures and walls of an encounter, and the cone coverage from the
+// cone origin kept in step with them. Both the application and the
+// headless replay drive the board through here, so they do the same work
+// for the same input.
+class Board
+{
+public:
+    // Keeps the shadow tables of up to radii cone radii, so switching
+    // between that many cone sizes doesn't rebuild one
+    explicit Board(std::size_t radii = 4);
+
+    const SpatialHash &ogres() const { return m_ogres; }
+    const SpatialHash &party() const { return m_party; }
+    // every cell with a creature in it
+    const OccupancyGrid &occupied() const { return m_occupied; }
+    const OccupancyGrid &walls() const { return m_walls; }
+    // Line of effect tables by radius. Getting one ahead of evaluate(),
+    // on another thread, keeps its build out of the frame.
+    ShadowCache &shadowTables() { return m_shadowTables; }
+
+    // Removes every creature and wall
+    void clear();
+
+    // Puts a creature in cell, returning false if a creature or a wall is
+    // there already
+    bool addCreature(const GridCell &cell, CreatureType type);
+
+    // Builds the wall in cell, or knocks it down, returning false if the
+    // cell is taken (or has no wall to knock down). conesChanged is set if
+    // that may change which cones evaluate() shows from its last origin.
+    bool addWall(const GridCell &cell, bool &conesChanged);
+    bool removeWall(const GridCell &cell, bool &conesChanged);
+
+    // Bitmask of the directions whose cone from origin covers every troll
+    // on the board, as WitchMode shows them. A troll the origin has no
+    // line of effect to is never covered, so while there is one no cone
+    // qualifies.
+    std::uint32_t evaluate(const std::shared_ptr<const ConeSet> &cones, const GridCell &origin);
+
+    // The best count placements of cones over every floor origin within
+    // reach of a troll, as findBestCones() ranks them, with line of effect
+    // through the walls
+    std::vector<ConePlacement> solve(const ConeSet &cones, std::size_t count);
+
+private:
+    bool wallChanged(const GridCell &cell, bool added);
+
+    SpatialHash m_ogres;
+    SpatialHash m_party;
+    OccupancyGrid m_occupied;
+    // the cells in m_ogres, for stepping m_coverage
+    OccupancyGrid m_ogreCells;
+    OccupancyGrid m_walls;
+    ShadowCache m_shadowTables;
+    // line of effect from the cone origin, for the last cone radius
+    std::unique_ptr<LineOfEffect> m_lineOfEffect;
+    bool m_lineOfEffectDirty;
+    // trolls covered by each cone from the cone origin, kept in step with
+    // m_lineOfEffect
+    std::unique_ptr<ConeCoverage> m_coverage;
+    bool m_coverageDirty;
+};
+
+#endif // #ifndef __Board_h_
@@ -0,0 +1,47 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    BoardSettings.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __BoardSettings_h_
+#define __BoardSettings_h_
+
+#include <cstddef>
+#include <cstdint>
+
+// What the application and ConeReplay have to agree on to do the same
+// work for the same input log
+
+// What clicks on the board do, chosen with the number keys
+enum BoardMode : std::uint8_t {
+    NoneMode = 0,
+    TrollMode,
+    PartyMode,
+    WitchMode,
+    WallMode
+};
+
+// Cone radii, in cells, that C cycles through, and the one to start with
+static const int CONE_RADII[] = { 1, 3, 6, 9, 12 };
+static const std::size_t CONE_SIZE_COUNT = sizeof(CONE_RADII) / sizeof(CONE_RADII[0]);
+static const std::size_t DEFAULT_CONE_SIZE = 2;
+
+// What a key press did to the board, besides changing the mode or the cone
+// size. The rest only move the camera or change what is drawn.
+enum BoardCommand : std::uint32_t {
+    NoCommand = 0,
+    // O, solve for the best cones
+    SolveCommand = 1,
+    // F9, load the encounter
+    LoadEncounterCommand = 2
+};
+
+// Placements O lists
+static const std::size_t SOLVER_RESULTS = 5;
+
+// Where F6 saves the encounter to and F9 loads it from
+static const char *const ENCOUNTER_FILE = "encounter.enc";
+// Where F7 records the input to, for ConeReplay
+static const char *const INPUT_FILE = "input.rec";
+
+#endif // #ifndef __BoardSettings_h_
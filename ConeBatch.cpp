@@ -0,0 +1,398 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeBatch.cpp
+-----------------------------------------------------------------------------
+
+Streams cone coverage queries without opening a window:
+
+    ConeBatch [input]
+
+Records are read from input, or stdin if none is given, one per line, with
+all coordinates in grid cells:
+
+    r <radius>      area radius for the following queries, up to
+                    MAX_RADIUS (default 6)
+    s <shape>       area shape for the following queries: cone (the
+                    default), burst, line or cylinder
+    o <x> <y> <z>   starts a query with its cone origin
+    c <x> <y> <z>   a creature for the current query
+    # ...           comment
+
+Each query is answered on stdout as soon as the next one starts:
+
+    <x> <y> <z> <all> <hits 0> ... <hits n-1>
+
+where all is a bitmask (in decimal) of the directions whose area covers
+every creature of the query, as in WitchMode, and hits i is the number of
+creatures covered by the area facing CONE_CASES[i]. Cones and lines have
+n = 26 directions; bursts and cylinders have none, so n = 1. Creatures are
+counted as they stream past, so memory use does not depend on the input
+size. Bursts and cylinders are measured a batch of creatures at a time with
+distance3Batch(), which uses the widest vector unit the CPU has.
+*/
+#include "ConeCache.h"
+#include "GridKernels.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+// Largest radius accepted, which keeps an AreaSet to a few megabytes
+static const int MAX_RADIUS = 64;
+
+// Burst and cylinder creatures measured at once
+static const std::size_t BATCH_CELLS = 1024;
+
+// Buffered stdout, since printf per line would dominate the run time
+class OutputBuffer
+{
+public:
+    explicit OutputBuffer(FILE *out) : m_out(out), m_used(0) {}
+    ~OutputBuffer() { flush(); }
+
+    void put(char c) {
+        if (m_used == sizeof(m_buffer)) flush();
+        m_buffer[m_used++] = c;
+    }
+
+    void put(long v) {
+        char digits[24];
+        int n = 0;
+        unsigned long u = v < 0 ? 0 - (unsigned long)v : (unsigned long)v;
+        do {
+            digits[n++] = char('0' + u % 10);
+            u /= 10;
+        } while (u);
+        if (v < 0) put('-');
+        while (n) put(digits[--n]);
+    }
+
+    void flush() {
+        std::fwrite(m_buffer, 1, m_used, m_out);
+        m_used = 0;
+    }
+
+private:
+    FILE *m_out;
+    std::size_t m_used;
+    char m_buffer[1 << 16];
+};
+
+// The areas of the current shape and radius. Only the set for the current
+// shape is held; the shape is switched on once per creature. Bursts and
+// cylinders need no set, since Query measures the distance to them.
+class Areas
+{
+public:
+    enum Shape { Cone, Burst, Line, Cylinder };
+
+    Areas() : m_shape(Cone), m_radius(6) { load(); }
+
+    // False if name is not a shape
+    bool setShape(const char *name, std::size_t length) {
+        static const char *const NAMES[] = { "cone", "burst", "line", "cylinder" };
+        for (int s = Cone; s <= Cylinder; s++) {
+            if (std::strlen(NAMES[s]) == length && std::memcmp(NAMES[s], name, length) == 0) {
+                m_shape = Shape(s);
+                load();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void setRadius(int radius) {
+        m_radius = radius;
+        load();
+    }
+
+    Shape shape() const { return m_shape; }
+    int radius() const { return m_radius; }
+    std::size_t size() const { return m_size; }
+    std::uint32_t allDirections() const { return (std::uint32_t(1) << m_size) - 1; }
+
+    // Cones and lines only
+    std::uint32_t directionsContaining(const GridCell &offset) const {
+        return m_shape == Cone ? m_cone->directionsContaining(offset)
+                               : m_line->directionsContaining(offset);
+    }
+
+private:
+    template <typename S>
+    void load(AreaCache<S> &cache, std::shared_ptr<const AreaSet<S> > &set) {
+        set = cache.get(m_radius);
+        m_size = set->size();
+    }
+
+    void load() {
+        m_cone.reset();
+        m_line.reset();
+        switch (m_shape) {
+        case Cone: load(caches().cone, m_cone); break;
+        case Line: load(caches().line, m_line); break;
+        case Burst:
+        case Cylinder: m_size = 1; break;
+        }
+    }
+
+    struct Caches
+    {
+        AreaCache<ConeShape> cone;
+        AreaCache<LineShape> line;
+    };
+
+    static Caches &caches() {
+        static Caches c;
+        return c;
+    }
+
+    Shape m_shape;
+    int m_radius;
+    std::size_t m_size;
+    std::shared_ptr<const ConeSet> m_cone;
+    std::shared_ptr<const AreaSet<LineShape> > m_line;
+};
+
+// Coverage of the query currently being read
+class Query
+{
+public:
+    Query() : m_active(false), m_all(0), m_measured(0) {}
+
+    // The areas are copied, so later r and s records only change the
+    // queries after this one
+    void start(const Areas &areas, const GridCell &origin) {
+        m_areas = areas;
+        m_origin = origin;
+        m_active = true;
+        m_all = areas.allDirections();
+        std::memset(m_hits, 0, sizeof(m_hits));
+        m_measured = 0;
+    }
+
+    bool active() const { return m_active; }
+
+    void add(const GridCell &creature) {
+        if (m_areas.shape() == Areas::Burst || m_areas.shape() == Areas::Cylinder) {
+            addMeasured(creature);
+            return;
+        }
+        // creatures can be anywhere an int reaches, so the offset is only
+        // taken once it is known to be near
+        GridCell offset;
+        if (!offsetWithin(m_origin, creature, m_areas.radius(), offset)) {
+            m_all = 0;
+            return;
+        }
+        std::uint32_t mask = m_areas.directionsContaining(offset);
+        m_all &= mask;
+        for (std::size_t i = 0; i < m_areas.size(); i++) {
+            m_hits[i] += (mask >> i) & 1;
+        }
+    }
+
+    void finish(OutputBuffer &out) {
+        if (!m_active) {
+            return;
+        }
+        countOffsets();
+        out.put(long(m_origin.x)); out.put(' ');
+        out.put(long(m_origin.y)); out.put(' ');
+        out.put(long(m_origin.z)); out.put(' ');
+        out.put(long(m_all));
+        for (std::size_t i = 0; i < m_areas.size(); i++) {
+            out.put(' ');
+            out.put(long(m_hits[i]));
+        }
+        out.put('\n');
+        m_active = false;
+    }
+
+private:
+    // A burst or a cylinder is every cell within its radius of the origin
+    // by distance3(), measured along the floor for a cylinder, which also
+    // reaches radius cells up and down. Creatures within the area's box
+    // are queued to be measured together.
+    void addMeasured(const GridCell &creature) {
+        GridCell offset;
+        if (!offsetWithin(m_origin, creature, m_areas.radius(), offset)) {
+            m_all = 0;
+            return;
+        }
+        m_x[m_measured] = offset.x;
+        m_y[m_measured] = m_areas.shape() == Areas::Cylinder ? 0 : offset.y;
+        m_z[m_measured] = offset.z;
+        if (++m_measured == BATCH_CELLS) {
+            countOffsets();
+        }
+    }
+
+    void countOffsets() {
+        distance3Batch(m_x, m_y, m_z, m_measured, GridCell(0, 0, 0), m_distances);
+        // counted without branching, as creatures fall in and out at random
+        const int radius = m_areas.radius();
+        std::size_t inside = 0;
+        for (std::size_t i = 0; i < m_measured; i++) {
+            inside += m_distances[i] <= radius;
+        }
+        m_hits[0] += inside;
+        if (inside != m_measured) {
+            m_all = 0;
+        }
+        m_measured = 0;
+    }
+
+    Areas m_areas;
+    GridCell m_origin;
+    bool m_active;
+    std::uint32_t m_all;
+    unsigned long m_hits[32];
+    // offsets from the origin waiting to be measured
+    std::size_t m_measured;
+    int m_x[BATCH_CELLS];
+    int m_y[BATCH_CELLS];
+    int m_z[BATCH_CELLS];
+    int m_distances[BATCH_CELLS];
+};
+
+static const char *skipSpace(const char *p, const char *end)
+{
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+// Parses a decimal integer, returning nullptr if there is none or it is
+// out of range for an int
+static const char *parseInt(const char *p, const char *end, int &v)
+{
+    p = skipSpace(p, end);
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return nullptr;
+    }
+
+    // INT_MIN has no positive counterpart, so negatives go one further
+    const long long limit = negative ? -static_cast<long long>(INT_MIN) : INT_MAX;
+    long long r = 0;
+    while (p != end && *p >= '0' && *p <= '9') {
+        r = r * 10 + (*p++ - '0');
+        if (r > limit) {
+            return nullptr;
+        }
+    }
+    v = int(negative ? -r : r);
+    return p;
+}
+
+static const char *parseCell(const char *p, const char *end, GridCell &c)
+{
+    if (!(p = parseInt(p, end, c.x))) return nullptr;
+    if (!(p = parseInt(p, end, c.y))) return nullptr;
+    return parseInt(p, end, c.z);
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *in = stdin;
+    if (argc > 1) {
+        in = std::fopen(argv[1], "rb");
+        if (!in) {
+            std::perror(argv[1]);
+            return 1;
+        }
+    }
+
+    Areas areas;
+    OutputBuffer out(stdout);
+    Query query;
+
+    static char buffer[1 << 16];
+    std::size_t kept = 0;
+    unsigned long line = 0;
+    bool eof = false;
+    while (!eof) {
+        std::size_t got = std::fread(buffer + kept, 1, sizeof(buffer) - kept, in);
+        eof = got == 0;
+        const char *p = buffer;
+        const char *end = buffer + kept + got;
+
+        for (;;) {
+            const char *eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+            if (!eol) {
+                // a last line with no newline still counts
+                if (eof && p != end) {
+                    eol = end;
+                } else {
+                    break;
+                }
+            }
+            line++;
+
+            const char *q = skipSpace(p, eol);
+            bool ok = true;
+            if (q != eol && *q != '#') {
+                char tag = *q++;
+                GridCell c;
+                int radius;
+                switch (tag) {
+                case 'o':
+                    ok = (q = parseCell(q, eol, c)) != nullptr;
+                    if (ok) {
+                        query.finish(out);
+                        query.start(areas, c);
+                    }
+                    break;
+                case 'c':
+                    ok = (q = parseCell(q, eol, c)) != nullptr && query.active();
+                    if (ok) {
+                        query.add(c);
+                    }
+                    break;
+                case 'r':
+                    ok = (q = parseInt(q, eol, radius)) != nullptr && radius >= 0 && radius <= MAX_RADIUS;
+                    if (ok) {
+                        areas.setRadius(radius);
+                    }
+                    break;
+                case 's':
+                    q = skipSpace(q, eol);
+                    {
+                        const char *name = q;
+                        while (q != eol && *q != ' ' && *q != '\t' && *q != '\r') q++;
+                        ok = areas.setShape(name, q - name);
+                    }
+                    break;
+                default:
+                    ok = false;
+                }
+                ok = ok && skipSpace(q, eol) == eol;
+            }
+
+            if (!ok) {
+                out.flush();
+                std::fprintf(stderr, "%s:%lu: bad record\n", argc > 1 ? argv[1] : "<stdin>", line);
+                return 1;
+            }
+
+            p = eol == end ? end : eol + 1;
+        }
+
+        kept = end - p;
+        if (kept == sizeof(buffer)) {
+            out.flush();
+            std::fprintf(stderr, "line %lu is too long\n", line + 1);
+            return 1;
+        }
+        std::memmove(buffer, p, kept);
+    }
+
+    query.finish(out);
+    if (in != stdin) {
+        std::fclose(in);
+    }
+    return 0;
+}
@@ -0,0 +1,451 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeBenchmark.cpp
+-----------------------------------------------------------------------------
+
+Headless microbenchmarks for the cone engine. Results are written as JSON,
+one object per benchmark, so runs from two builds can be diffed:
+
+    ConeBenchmark [output.json]
+
+*/
+#include "BoardSettings.h"
+#include "ConeCache.h"
+#include "ConeCoverage.h"
+#include "ConeMesh.h"
+#include "ConeSolver.h"
+#include "CoverageMap.h"
+#include "EncounterFile.h"
+#include "GridKernels.h"
+#include "OccupancyGrid.h"
+#include "VoxelRay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <string>
+
+// Keeps the optimiser from throwing away benchmarked work
+static volatile std::uint64_t g_sink;
+
+// Size of the square board creatures are spread over, in cells
+static const int BOARD_SIZE = 200;
+
+class BenchmarkReport
+{
+public:
+    explicit BenchmarkReport(FILE *out) : m_out(out), m_first(true) {
+        std::fprintf(m_out, "{\n  \"benchmarks\": [");
+    }
+
+    ~BenchmarkReport() {
+        std::fprintf(m_out, "\n  ]\n}\n");
+    }
+
+    // Runs fn(), which does opsPerCall operations, until at least
+    // MIN_TIME has passed and reports the mean time per operation
+    template <typename Fn>
+    void run(const std::string &name, long param, std::size_t opsPerCall, Fn fn) {
+        typedef std::chrono::steady_clock Clock;
+        const std::chrono::duration<double> MIN_TIME(0.2);
+
+        fn(); // warm up
+
+        std::size_t calls = 0;
+        Clock::time_point start = Clock::now();
+        std::chrono::duration<double> elapsed(0);
+        do {
+            fn();
+            calls++;
+            elapsed = Clock::now() - start;
+        } while (elapsed < MIN_TIME);
+
+        double ops = double(calls) * opsPerCall;
+        double ns = elapsed.count() * 1e9 / ops;
+        std::fprintf(m_out, "%s\n    { \"name\": \"%s\", \"param\": %ld, \"iterations\": %.0f, "
+                            "\"ns_per_op\": %.3f, \"ops_per_sec\": %.1f }",
+                     m_first ? "" : ",", name.c_str(), param, ops, ns, 1e9 / ns);
+        std::fflush(m_out);
+        m_first = false;
+    }
+
+private:
+    FILE *m_out;
+    bool m_first;
+};
+
+static GridCell randomCell(std::mt19937 &rng, int extent)
+{
+    std::uniform_int_distribution<int> d(-extent, extent);
+    return GridCell(d(rng), 0, d(rng));
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *out = stdout;
+    if (argc > 1) {
+        out = std::fopen(argv[1], "w");
+        if (!out) {
+            std::perror(argv[1]);
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(42);
+    {
+        BenchmarkReport report(out);
+
+        // Building the 26 cones of each radius from scratch
+        for (int radius : CONE_RADII) {
+            report.run("template_generation", radius, 1, [&]() {
+                ConeSet cones(radius);
+                g_sink += cones[0].cellCount();
+            });
+        }
+
+        const int radius = 6;
+        ConeSet cones(radius);
+
+        // The other area shapes, at the default cone radius
+        report.run("burst_generation", radius, 1, [&]() {
+            AreaSet<BurstShape> areas(radius);
+            g_sink += areas[0].cellCount();
+        });
+        report.run("line_generation", radius, 1, [&]() {
+            AreaSet<LineShape> areas(radius);
+            g_sink += areas[0].cellCount();
+        });
+        report.run("cylinder_generation", radius, 1, [&]() {
+            AreaSet<CylinderShape> areas(radius);
+            g_sink += areas[0].cellCount();
+        });
+
+        // One creature against all 26 directions at once, and against a
+        // single direction
+        {
+            std::vector<GridCell> offsets(4096);
+            for (GridCell &o : offsets) {
+                o = randomCell(rng, radius + 1);
+            }
+
+            report.run("directions_containing", radius, offsets.size(), [&]() {
+                std::uint32_t m = 0;
+                for (const GridCell &o : offsets) {
+                    m ^= cones.directionsContaining(o);
+                }
+                g_sink += m;
+            });
+
+            report.run("cone_contains", radius, offsets.size(), [&]() {
+                std::uint32_t n = 0;
+                for (const GridCell &o : offsets) {
+                    n += cones[7].contains(o);
+                }
+                g_sink += n;
+            });
+
+            report.run("distance3", radius, offsets.size(), [&]() {
+                int n = 0;
+                for (const GridCell &o : offsets) {
+                    n += distance3(o);
+                }
+                g_sink += n;
+            });
+        }
+
+        // The WitchMode evaluation of all 26 directions, and the solver
+        for (long count : { 10L, 100L, 10000L }) {
+            SpatialHash creatures;
+            for (long i = 0; i < count; i++) {
+                creatures.insert(randomCell(rng, BOARD_SIZE / 2));
+            }
+
+            // keep every creature in reach, so the whole board is walked
+            SpatialHash cluster;
+            for (long i = 0; i < count; i++) {
+                cluster.insert(randomCell(rng, radius));
+            }
+
+            std::vector<GridCell> origins(256);
+            for (GridCell &o : origins) {
+                o = randomCell(rng, BOARD_SIZE / 2);
+            }
+
+            report.run("evaluate_board", count, origins.size(), [&]() {
+                std::uint32_t m = 0;
+                for (const GridCell &o : origins) {
+                    m ^= conesCoveringAll(cones, creatures, o);
+                }
+                g_sink += m;
+            });
+
+            report.run("evaluate_cluster", count, 1, [&]() {
+                g_sink += conesCoveringAll(cones, cluster, GridCell(0, 0, 0));
+            });
+
+            SpatialHash allies;
+            report.run("best_cones", count, 1, [&]() {
+                auto best = findBestCones(cones, creatures, allies,
+                                          GridCell(-BOARD_SIZE / 2, 0, -BOARD_SIZE / 2),
+                                          GridCell(BOARD_SIZE / 2, 0, BOARD_SIZE / 2), 5);
+                g_sink += best.size();
+            });
+
+            // The coverage overlay over the middle of the board, in full and
+            // for one troll added
+            const GridCell mapOrigin(-BOARD_SIZE / 4, 0, -BOARD_SIZE / 4);
+            ConeCoverageMap map(std::make_shared<const ConeSet>(radius));
+            report.run("coverage_map", count, 1, [&]() {
+                map.reset(creatures, mapOrigin, BOARD_SIZE / 2, BOARD_SIZE / 2);
+                g_sink += map.peak();
+            });
+
+            // Each troll goes on a different floor cell of the map, as when
+            // placing them by hand. A pass over the cells adds at most
+            // extent^2 to any count, so the map is counted again before a
+            // count could wrap, which only the fastest machines get to.
+            std::vector<GridCell> adds;
+            for (int z = 0; z < BOARD_SIZE / 2; z++) {
+                for (int x = 0; x < BOARD_SIZE / 2; x++) {
+                    adds.push_back(mapOrigin + GridCell(x, 0, z));
+                }
+            }
+            std::shuffle(adds.begin(), adds.end(), rng);
+            const int extent = 2 * radius + 1;
+            const int maxCount = std::numeric_limits<std::uint16_t>::max();
+            std::size_t next = 0, passes = 0;
+            std::size_t safePasses = (maxCount - map.peak()) / (extent * extent);
+            report.run("coverage_map_add", count, 1, [&]() {
+                GridCell lo, hi;
+                g_sink += map.add(adds[next], lo, hi);
+                if (++next == adds.size()) {
+                    next = 0;
+                    if (++passes == safePasses) {
+                        map.reset(creatures, mapOrigin, BOARD_SIZE / 2, BOARD_SIZE / 2);
+                        passes = 0;
+                        safePasses = (maxCount - map.peak()) / (extent * extent);
+                    }
+                }
+            });
+        }
+
+        // The CPU side of building the cone scene: fetching each radius from
+        // a cold cache and extracting the surface of all 26 cones
+        for (int radius : CONE_RADII) {
+            report.run("scene_build", radius, 1, [&]() {
+                ConeCache cache;
+                std::shared_ptr<const ConeSet> set = cache.get(radius);
+                std::size_t faces = 0;
+                for (std::size_t i = 0; i < set->size(); i++) {
+                    forEachConeFace((*set)[i], [&](const GridCell &, const GridCell *) {
+                        faces++;
+                    });
+                }
+                g_sink += faces;
+            });
+        }
+
+        // Line of effect: the shadow tables, a full recompute when the
+        // origin moves, and the update for one wall added and removed
+        for (int radius : CONE_RADII) {
+            report.run("shadow_table", radius, 1, [&]() {
+                ShadowTable table(radius);
+                g_sink += table.cellCount();
+            });
+        }
+        {
+            auto table = std::make_shared<const ShadowTable>(radius);
+            OccupancyGrid walls;
+            for (int i = 0; i < 200; i++) {
+                GridCell c = randomCell(rng, radius);
+                c.y = i % radius;
+                walls.set(c);
+            }
+            LineOfEffect visible(table);
+
+            report.run("line_of_effect_reset", radius, 1, [&]() {
+                visible.reset(GridCell(0, 0, 0), walls);
+                g_sink += visible.visible(GridCell(1, 0, 0));
+            });
+
+            const GridCell wall(2, 1, -1);
+            walls.reset(wall);
+            visible.reset(GridCell(0, 0, 0), walls);
+            report.run("line_of_effect_wall", radius, 2, [&]() {
+                std::uint32_t affected = 0;
+                auto flipped = [&](const GridCell &o) { affected |= cones.directionsContaining(o); };
+                visible.addWall(wall, flipped);
+                visible.removeWall(wall, flipped);
+                g_sink += affected;
+            });
+        }
+
+        // Cone coverage as the cursor walks one cell at a time over a cluster
+        // of trolls stacked up to the cone radius, counted again at every
+        // cell and then stepped
+        for (long count : { 10L, 1000L, 10000L }) {
+            SpatialHash creatures;
+            OccupancyGrid cells;
+            for (long i = 0; i < count; i++) {
+                GridCell c = randomCell(rng, 2 * radius);
+                c.y = int(i % (2 * radius + 1)) - radius;
+                if (!cells.test(c)) {
+                    creatures.insert(c);
+                    cells.set(c);
+                }
+            }
+
+            // round and round a square, so the walk can be repeated
+            std::vector<GridCell> walk;
+            const int side = 2 * radius;
+            for (int i = 0; i < side; i++) walk.push_back(GridCell(-radius + i, 0, -radius));
+            for (int i = 0; i < side; i++) walk.push_back(GridCell(radius, 0, -radius + i));
+            for (int i = 0; i < side; i++) walk.push_back(GridCell(radius - i, 0, radius));
+            for (int i = 0; i < side; i++) walk.push_back(GridCell(-radius, 0, radius - i));
+
+            ConeCoverage coverage(std::make_shared<const ConeSet>(radius));
+            LineOfEffect visible(std::make_shared<const ShadowTable>(radius));
+            OccupancyGrid walls;
+            report.run("coverage_recount", count, walk.size(), [&]() {
+                std::uint32_t m = 0;
+                for (const GridCell &o : walk) {
+                    visible.reset(o, walls);
+                    coverage.reset(creatures, visible);
+                    m ^= coverage.coveringAll(creatures.size());
+                }
+                g_sink += m;
+            });
+
+            visible.reset(walk.back(), walls);
+            coverage.reset(creatures, visible);
+            report.run("coverage_step", count, walk.size(), [&]() {
+                std::uint32_t m = 0;
+                for (const GridCell &o : walk) {
+                    coverage.step(o, cells);
+                    m ^= coverage.coveringAll(creatures.size());
+                }
+                g_sink += m;
+            });
+        }
+
+        // Vertical mode picking: rays from above the board down onto it,
+        // through 10000 creatures
+        {
+            OccupancyGrid occupied;
+            for (int i = 0; i < 10000; i++) {
+                GridCell c = randomCell(rng, BOARD_SIZE / 2);
+                c.y = i % 4;
+                occupied.set(c);
+            }
+
+            std::uniform_real_distribution<double> d(-BOARD_SIZE / 2, BOARD_SIZE / 2);
+            std::vector<double> rays;
+            for (int i = 0; i < 1024; i++) {
+                double o[6] = { d(rng), 40, d(rng), d(rng) / 100, -1, d(rng) / 100 };
+                rays.insert(rays.end(), o, o + 6);
+            }
+
+            report.run("voxel_pick", 10000, rays.size() / 6, [&]() {
+                long n = 0;
+                VoxelHit hit;
+                for (std::size_t i = 0; i < rays.size(); i += 6) {
+                    n += castVoxelRay(&rays[i], &rays[i + 3], 432, [&](const GridCell &c) {
+                        return c.y < 0 || occupied.test(c);
+                    }, hit) ? hit.cell.y : 0;
+                }
+                g_sink += n;
+            });
+        }
+
+        // Burst containment and the 45 degree test over 10000 creatures, one
+        // at a time and then in batches with each set of kernels the CPU has
+        {
+            const long count = 10000;
+            CellArrays cells;
+            for (long i = 0; i < count; i++) {
+                GridCell c = randomCell(rng, 2 * radius);
+                c.y = int(i % (2 * radius + 1)) - radius;
+                cells.push_back(c);
+            }
+            const GridCell dir = CONE_CASES[7];
+
+            report.run("burst_contains_each", count, count, [&]() {
+                int n = 0;
+                for (std::size_t i = 0; i < cells.size(); i++) {
+                    n += distance3(cells[i]) <= radius;
+                }
+                g_sink += n;
+            });
+            report.run("within45_each", count, count, [&]() {
+                int n = 0;
+                for (std::size_t i = 0; i < cells.size(); i++) {
+                    n += within45(cells[i], dir);
+                }
+                g_sink += n;
+            });
+
+            const std::string best = gridKernelName();
+            std::vector<int> distances(count);
+            std::vector<std::uint8_t> inside(count);
+            for (const char *kernels : { "scalar", "sse4.1", "avx2" }) {
+                if (!useGridKernels(kernels)) {
+                    continue;
+                }
+                report.run(std::string("burst_contains_") + kernels, count, count, [&]() {
+                    distance3Batch(cells, GridCell(0, 0, 0), &distances[0]);
+                    int n = 0;
+                    for (int d : distances) {
+                        n += d <= radius;
+                    }
+                    g_sink += n;
+                });
+                report.run(std::string("within45_") + kernels, count, count, [&]() {
+                    within45Batch(cells, GridCell(0, 0, 0), dir, &inside[0]);
+                    int n = 0;
+                    for (std::uint8_t in : inside) {
+                        n += in;
+                    }
+                    g_sink += n;
+                });
+            }
+            useGridKernels(best.c_str());
+        }
+
+        // Opening a saved encounter and storing its creatures, as F9 does
+        // without the scene
+        {
+            const long count = 100000;
+            const char *path = "ConeBenchmark.enc";
+            std::vector<GridCell> cells;
+            std::vector<CreatureType> types;
+            for (long i = 0; i < count; i++) {
+                cells.push_back(randomCell(rng, BOARD_SIZE * 4));
+                types.push_back(i % 8 ? TrollCreature : AllyCreature);
+            }
+
+            std::string error;
+            if (saveEncounter(path, cells, types, error)) {
+                report.run("encounter_load", count, 1, [&]() {
+                    EncounterFile file;
+                    SpatialHash ogres(CHUNK_SHIFT), party(CHUNK_SHIFT);
+                    if (file.open(path)) {
+                        for (std::size_t i = 0; i < file.size(); i++) {
+                            (file.types()[i] == AllyCreature ? party : ogres).insert(file.cells()[i]);
+                        }
+                    }
+                    g_sink += ogres.size() + party.size();
+                });
+                std::remove(path);
+            } else {
+                std::fprintf(stderr, "%s\n", error.c_str());
+            }
+        }
+    }
+
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeCache.cpp
+-----------------------------------------------------------------------------
+*/
+#include "ConeCache.h"
+
+//-------------------------------------------------------------------------------------
+template <typename Shape>
+AreaCache<Shape>::AreaCache(std::size_t capacity)
+    : m_capacity(std::max<std::size_t>(capacity, 1))
+{
+}
+
+template <typename Shape>
+std::shared_ptr<const AreaSet<Shape> > AreaCache<Shape>::get(int radius)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        for (auto it = m_sets.begin(); it != m_sets.end(); ++it) {
+            if ((*it)->radius() == radius) {
+                m_sets.splice(m_sets.begin(), m_sets, it);
+                return m_sets.front();
+            }
+        }
+    }
+
+    // Build outside the lock so other radii can still be looked up. If
+    // another thread built the same radius meanwhile, theirs is kept.
+    std::shared_ptr<const AreaSet<Shape> > set = std::make_shared<AreaSet<Shape> >(radius);
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    for (auto it = m_sets.begin(); it != m_sets.end(); ++it) {
+        if ((*it)->radius() == radius) {
+            m_sets.splice(m_sets.begin(), m_sets, it);
+            return m_sets.front();
+        }
+    }
+
+    m_sets.push_front(set);
+    if (m_sets.size() > m_capacity) {
+        m_sets.pop_back();
+    }
+    return set;
+}
+
+template class AreaCache<ConeShape>;
+template class AreaCache<BurstShape>;
+template class AreaCache<LineShape>;
+template class AreaCache<CylinderShape>;
@@ -0,0 +1,40 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeCache.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __ConeCache_h_
+#define __ConeCache_h_
+
+#include "ConeTemplate.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+
+// Keeps the AreaSets of the last few radii asked for, dropping the least
+// recently used one when full. Safe to share between threads.
+template <typename Shape>
+class AreaCache
+{
+public:
+    explicit AreaCache(std::size_t capacity = 4);
+
+    // The areas for radius (in cells), built on first use
+    std::shared_ptr<const AreaSet<Shape> > get(int radius);
+
+private:
+    std::mutex m_lock;
+    std::size_t m_capacity;
+    // most recently used first
+    std::list<std::shared_ptr<const AreaSet<Shape> > > m_sets;
+};
+
+typedef AreaCache<ConeShape> ConeCache;
+
+extern template class AreaCache<ConeShape>;
+extern template class AreaCache<BurstShape>;
+extern template class AreaCache<LineShape>;
+extern template class AreaCache<CylinderShape>;
+
+#endif // #ifndef __ConeCache_h_
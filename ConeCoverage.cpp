@@ -0,0 +1,146 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeCoverage.cpp
+-----------------------------------------------------------------------------
+*/
+#include "ConeCoverage.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// Counts, for each of 32 bits, how many masks added had it set. The counts
+// are kept sliced into bit-planes, so adding a mask is a ripple carry over
+// a plane or two rather than a loop over every bit.
+class BitCounter
+{
+public:
+    BitCounter() : m_used(0) { std::fill(m_planes, m_planes + 32, 0); }
+
+    void add(std::uint32_t mask) {
+        for (int p = 0; mask; p++) {
+            const std::uint32_t carry = m_planes[p] & mask;
+            m_planes[p] ^= mask;
+            mask = carry;
+            m_used = std::max(m_used, p + 1);
+        }
+    }
+
+    std::size_t count(std::size_t bit) const {
+        std::size_t n = 0;
+        for (int p = 0; p < m_used; p++) {
+            n |= std::size_t((m_planes[p] >> bit) & 1) << p;
+        }
+        return n;
+    }
+
+private:
+    std::uint32_t m_planes[32];
+    int m_used;
+};
+
+//-------------------------------------------------------------------------------------
+template <typename Shape>
+AreaCoverage<Shape>::AreaCoverage(std::shared_ptr<const AreaSet<Shape> > areas)
+    : m_areas(areas),
+      m_stepCost(0),
+      m_reach(0)
+{
+    std::fill(m_covered, m_covered + 32, 0);
+
+    // An offset changes when it is covered differently from the old origin
+    // than from the new one, where it sits at offset - step. Both lie in
+    // the template box grown by a cell.
+    const int r = m_areas->radius() + 1;
+    for (const GridCell &step : CONE_CASES) {
+        std::vector<EdgeRun> &edges = m_edges[stepIndex(step)];
+        for (int z = -r; z <= r; z++) {
+            for (int y = -r; y <= r; y++) {
+                for (int x0 = -r; x0 <= r; x0 += 64) {
+                    EdgeRun run;
+                    run.start = GridCell(x0, y, z);
+                    run.width = std::min(64, r - x0 + 1);
+                    run.cells = 0;
+                    for (int k = 0; k < run.width; k++) {
+                        const GridCell offset(x0 + k, y, z);
+                        if (m_areas->directionsContaining(offset) != m_areas->directionsContaining(offset - step)) {
+                            run.cells |= std::uint64_t(1) << k;
+                        }
+                    }
+                    if (run.cells) {
+                        edges.push_back(run);
+                    }
+                }
+            }
+        }
+        m_stepCost = std::max(m_stepCost, edges.size());
+    }
+}
+
+template <typename Shape>
+void AreaCoverage<Shape>::reset(const SpatialHash &creatures, const LineOfEffect &visible)
+{
+    m_origin = visible.origin();
+    m_reach = 0;
+    BitCounter covered;
+    creatures.query(m_origin, m_areas->radius(), [&](const GridCell &creature) {
+        m_reach++;
+        const GridCell offset = creature - m_origin;
+        if (visible.visible(offset)) {
+            covered.add(m_areas->directionsContaining(offset));
+        }
+    });
+
+    std::fill(m_covered, m_covered + 32, 0);
+    for (std::size_t d = 0; d < m_areas->size(); d++) {
+        m_covered[d] = covered.count(d);
+    }
+}
+
+template <typename Shape>
+bool AreaCoverage<Shape>::step(const GridCell &origin, const OccupancyGrid &creatures)
+{
+    const GridCell step = origin - m_origin;
+    if (step == GridCell(0, 0, 0) || std::abs(step.x) > 1 || std::abs(step.y) > 1 || std::abs(step.z) > 1) {
+        return false;
+    }
+
+    const int r = m_areas->radius() + 1;
+    const OccupancyGrid::Window window(creatures,
+                                       GridCell(m_origin.x - r, m_origin.y - r, m_origin.z - r),
+                                       GridCell(m_origin.x + r, m_origin.y + r, m_origin.z + r));
+    BitCounter gained, lost;
+    for (const EdgeRun &run : m_edges[stepIndex(step)]) {
+        std::uint64_t cells = run.cells & window.row(m_origin + run.start, run.width);
+        for (int k = 0; cells; k++, cells >>= 1) {
+            if (cells & 1) {
+                const GridCell offset(run.start.x + k, run.start.y, run.start.z);
+                const std::uint32_t before = m_areas->directionsContaining(offset);
+                const std::uint32_t after = m_areas->directionsContaining(offset - step);
+                gained.add(after & ~before);
+                lost.add(before & ~after);
+            }
+        }
+    }
+    for (std::size_t d = 0; d < m_areas->size(); d++) {
+        m_covered[d] += gained.count(d) - lost.count(d);
+    }
+    m_origin = origin;
+    return true;
+}
+
+template <typename Shape>
+std::uint32_t AreaCoverage<Shape>::coveringAll(std::size_t total) const
+{
+    std::uint32_t result = 0;
+    for (std::size_t d = 0; d < m_areas->size(); d++) {
+        if (m_covered[d] == total) {
+            result |= std::uint32_t(1) << d;
+        }
+    }
+    return result;
+}
+
+template class AreaCoverage<ConeShape>;
+template class AreaCoverage<BurstShape>;
+template class AreaCoverage<LineShape>;
+template class AreaCoverage<CylinderShape>;
@@ -0,0 +1,101 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeCoverage.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __ConeCoverage_h_
+#define __ConeCoverage_h_
+
+#include "ConeTemplate.h"
+#include "LineOfEffect.h"
+#include "OccupancyGrid.h"
+#include "SpatialHash.h"
+
+#include <memory>
+#include <vector>
+
+// How many creatures each direction of an AreaSet covers from one origin,
+// kept up to date as the origin and the creatures change instead of being
+// counted again from scratch.
+//
+// Stepping the origin to a neighbouring cell only changes the directions
+// covering the cells on the edges of the areas. Those cells are worked out
+// once per step direction, as bitmasks along rows of the template box, so
+// a step ANDs them with the creatures in each row and visits the creatures
+// left alone, however many there are nearby.
+template <typename Shape>
+class AreaCoverage
+{
+public:
+    explicit AreaCoverage(std::shared_ptr<const AreaSet<Shape> > areas);
+
+    const AreaSet<Shape> &areas() const { return *m_areas; }
+    const GridCell &origin() const { return m_origin; }
+
+    // Counts every creature within reach of visible.origin() that it has
+    // line of effect to. visible must have the same radius as the areas.
+    void reset(const SpatialHash &creatures, const LineOfEffect &visible);
+
+    // Moves the origin by one cell along any axes, looking the creatures
+    // up in creatures, which holds each of their cells. Every cell must
+    // have line of effect from both origins. Returns false, and changes
+    // nothing, if origin isn't a neighbour of the current one.
+    bool step(const GridCell &origin, const OccupancyGrid &creatures);
+
+    // The most rows a step looks at. Counting from scratch visits each
+    // creature in reach once, at about the same cost as a row, and a step
+    // only visits those on the edges on top.
+    std::size_t stepCost() const { return m_stepCost; }
+    // Creatures within reach when last counted from scratch
+    std::size_t reach() const { return m_reach; }
+
+    // A creature at offset from the origin was placed or came into line of
+    // effect (add), or went out of it (remove)
+    void add(const GridCell &offset) { count(m_areas->directionsContaining(offset), 1); }
+    void remove(const GridCell &offset) { count(m_areas->directionsContaining(offset), -1); }
+
+    // Creatures covered by direction d
+    std::size_t covered(std::size_t d) const { return m_covered[d]; }
+
+    // Bitmask of the directions covering all total creatures
+    std::uint32_t coveringAll(std::size_t total) const;
+
+private:
+    // Up to 64 cells of a row of offsets, bit k standing for start + (k, 0, 0)
+    struct EdgeRun
+    {
+        GridCell start;
+        int width;
+        std::uint64_t cells;
+    };
+
+    static std::size_t stepIndex(const GridCell &step) {
+        return std::size_t((step.z + 1) * 9 + (step.y + 1) * 3 + (step.x + 1));
+    }
+
+    void count(std::uint32_t mask, int delta) {
+        for (std::size_t d = 0; mask; d++, mask >>= 1) {
+            if (mask & 1) {
+                m_covered[d] += delta;
+            }
+        }
+    }
+
+    std::shared_ptr<const AreaSet<Shape> > m_areas;
+    GridCell m_origin;
+    std::size_t m_covered[32];
+    std::size_t m_stepCost;
+    std::size_t m_reach;
+    // For each step, by stepIndex(), the offsets from the old origin whose
+    // covering directions differ from the new one
+    std::vector<EdgeRun> m_edges[27];
+};
+
+typedef AreaCoverage<ConeShape> ConeCoverage;
+
+extern template class AreaCoverage<ConeShape>;
+extern template class AreaCoverage<BurstShape>;
+extern template class AreaCoverage<LineShape>;
+extern template class AreaCoverage<CylinderShape>;
+
+#endif // #ifndef __ConeCoverage_h_
@@ -0,0 +1,15 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeMesh.cpp
+-----------------------------------------------------------------------------
+*/
+#include "ConeMesh.h"
+
+const CubeFace CUBE_FACES[6] = {
+    { GridCell( 1, 0, 0), { GridCell(1, 0, 0), GridCell(1, 1, 0), GridCell(1, 1, 1), GridCell(1, 0, 1) } },
+    { GridCell(-1, 0, 0), { GridCell(0, 0, 0), GridCell(0, 0, 1), GridCell(0, 1, 1), GridCell(0, 1, 0) } },
+    { GridCell(0,  1, 0), { GridCell(0, 1, 0), GridCell(0, 1, 1), GridCell(1, 1, 1), GridCell(1, 1, 0) } },
+    { GridCell(0, -1, 0), { GridCell(0, 0, 0), GridCell(1, 0, 0), GridCell(1, 0, 1), GridCell(0, 0, 1) } },
+    { GridCell(0, 0,  1), { GridCell(0, 0, 1), GridCell(1, 0, 1), GridCell(1, 1, 1), GridCell(0, 1, 1) } },
+    { GridCell(0, 0, -1), { GridCell(0, 0, 0), GridCell(0, 1, 0), GridCell(1, 1, 0), GridCell(1, 0, 0) } },
+};
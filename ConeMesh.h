@@ -0,0 +1,56 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeMesh.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __ConeMesh_h_
+#define __ConeMesh_h_
+
+#include "ConeTemplate.h"
+
+// A face of a unit cube, with its outward normal and its corners wound
+// counter-clockwise when seen from outside
+struct CubeFace
+{
+    GridCell normal;
+    GridCell corners[4];
+};
+
+extern const CubeFace CUBE_FACES[6];
+
+// Calls emit(normal, corners) for every voxel face on the surface of the
+// area (an OrientedArea of any shape), with the corners in cells relative
+// to its origin. Only the cells keep(cell) is true for are drawn, e.g. the
+// ones with line of effect from the origin. Faces shared by two drawn
+// voxels are skipped.
+template <typename Area, typename Keep, typename Emit>
+void forEachConeFace(const Area &cone, Keep keep, Emit emit)
+{
+    for (std::size_t i = 0; i < cone.cellCount(); i++) {
+        const GridCell cell = cone.cell(i);
+        if (!keep(cell)) {
+            continue;
+        }
+        for (const CubeFace &face : CUBE_FACES) {
+            const GridCell next = cell + face.normal;
+            if (cone.contains(next) && keep(next)) {
+                continue;
+            }
+
+            const GridCell corners[4] = {
+                cell + face.corners[0], cell + face.corners[1],
+                cell + face.corners[2], cell + face.corners[3]
+            };
+            emit(face.normal, corners);
+        }
+    }
+}
+
+// As above, drawing every cell of the area
+template <typename Area, typename Emit>
+void forEachConeFace(const Area &cone, Emit emit)
+{
+    forEachConeFace(cone, [](const GridCell &) { return true; }, emit);
+}
+
+#endif // #ifndef __ConeMesh_h_
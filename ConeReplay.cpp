@@ -0,0 +1,265 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeReplay.cpp
+-----------------------------------------------------------------------------
+
+Replays an input log recorded by the application (F7) without opening a
+window, as fast as it will go, and reports how long each kind of event
+took to handle:
+
+    ConeReplay input.rec [output.json]
+
+The board is driven through the same Board calls the application makes,
+from the cells picking resolved to when the log was recorded, so nothing
+depends on the camera or the scene. As in the application, cones are only
+evaluated or solved for once the log says they were ready, and F9 loads
+encounter.enc from the current directory. Rendering, the coverage
+overlay and the cone meshes are not replayed.
+
+The report is JSON, with per event type latency percentiles and a
+checksum of every cone evaluation and solver result, so two builds can be
+checked for doing the same work as well as for how fast they did it.
+*/
+#include "Board.h"
+#include "BoardSettings.h"
+#include "ConeCache.h"
+#include "InputLog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const char *const EVENT_NAMES[] = {
+    "key_pressed", "key_released", "picked", "clicked", "creature", "wall", "cones_ready"
+};
+static const std::size_t EVENT_TYPES = sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]);
+
+// The application's side of the board: the mode it is in, where the
+// cursor is and whether its cones are ready, and what they last showed
+class Session
+{
+public:
+    Session()
+        : m_board(CONE_SIZE_COUNT),
+          m_coneCache(CONE_SIZE_COUNT),
+          m_mode(NoneMode),
+          m_coneSize(CONE_SIZE_COUNT),
+          m_conesReady(false),
+          m_conesDirty(false),
+          m_checksum(0)
+    {
+    }
+
+    std::uint64_t checksum() const { return m_checksum; }
+
+    // Builds the cones and line of effect tables of every size the events
+    // use. The application builds them in the background, so they aren't
+    // timed.
+    void prepare(const std::vector<InputEvent> &events) {
+        bool used[CONE_SIZE_COUNT] = {};
+        for (const InputEvent &e : events) {
+            if (e.coneSize < CONE_SIZE_COUNT) {
+                used[e.coneSize] = true;
+            }
+        }
+        for (std::size_t i = 0; i < CONE_SIZE_COUNT; i++) {
+            if (used[i]) {
+                m_coneCache.get(CONE_RADII[i]);
+                m_board.shadowTables().get(CONE_RADII[i]);
+            }
+        }
+    }
+
+    // Handles one event, returning false if the log is bad
+    bool handle(const InputEvent &e) {
+        if (e.coneSize >= CONE_SIZE_COUNT || e.type >= EVENT_TYPES) {
+            return false;
+        }
+        // The state the event left the application in, so the evaluation
+        // a key's change of mode or cone size leads to is timed with it.
+        // Cones are evaluated again on entering WitchMode and once the
+        // cones of a new size are ready.
+        if (e.coneSize != m_coneSize) {
+            m_coneSize = e.coneSize;
+            m_cones = m_coneCache.get(CONE_RADII[m_coneSize]);
+            m_conesReady = false;
+            m_conesDirty = true;
+        }
+        if (e.mode != m_mode) {
+            m_mode = e.mode;
+            m_conesDirty = m_conesDirty || m_mode == WitchMode;
+        }
+
+        switch (e.type) {
+        case KeyPressedEvent:
+            // as TutorialApplication::solveCones(), which waits for the cones
+            if (e.code == SolveCommand && m_conesReady) {
+                for (const ConePlacement &p : m_board.solve(*m_cones, SOLVER_RESULTS)) {
+                    mix(p.origin.x);
+                    mix(p.origin.y);
+                    mix(p.origin.z);
+                    mix(p.direction);
+                    mix(p.covered);
+                }
+            } else if (e.code == LoadEncounterCommand) {
+                loadEncounter();
+            }
+            break;
+        case KeyReleasedEvent:
+            break;
+        case PickedEvent:
+            if (e.cursor != m_cursorCell || e.point != m_pointCell) {
+                m_cursorCell = e.cursor;
+                m_pointCell = e.point;
+                m_conesDirty = true;
+            }
+            break;
+        case ClickedEvent:
+            if (m_mode == TrollMode || m_mode == PartyMode) {
+                const CreatureType type = m_mode == PartyMode ? AllyCreature : TrollCreature;
+                if (m_board.addCreature(e.cursor, type) && type == TrollCreature) {
+                    m_conesDirty = true;
+                }
+            } else if (m_mode == WallMode) {
+                // as TutorialApplication::toggleWall()
+                const GridCell cell = e.vertical ? e.hit : e.cursor;
+                bool changed = false;
+                if (m_board.walls().test(cell)) {
+                    m_board.removeWall(cell, changed);
+                } else {
+                    m_board.addWall(e.cursor, changed);
+                }
+                m_conesDirty = m_conesDirty || changed;
+            }
+            break;
+        case CreatureEvent:
+            m_board.addCreature(e.cursor, CreatureType(e.code));
+            m_conesDirty = true;
+            break;
+        case WallEvent: {
+            bool changed;
+            m_board.addWall(e.cursor, changed);
+            m_conesDirty = true;
+            break;
+        }
+        case ConesReadyEvent:
+            m_conesReady = true;
+            m_conesDirty = true;
+            break;
+        }
+
+        // what the next frame would do
+        if (m_conesDirty && m_mode == WitchMode && m_conesReady) {
+            m_conesDirty = false;
+            mix(m_board.evaluate(m_cones, m_pointCell));
+        }
+        return true;
+    }
+
+private:
+    void loadEncounter() {
+        EncounterFile file;
+        if (!file.open(ENCOUNTER_FILE)) {
+            std::fprintf(stderr, "Couldn't load the encounter: %s\n", file.error().c_str());
+            return;
+        }
+        m_board.clear();
+        for (std::size_t i = 0; i < file.size(); i++) {
+            m_board.addCreature(file.cells()[i], file.types()[i]);
+        }
+        m_conesDirty = true;
+    }
+
+    // FNV-1a, a word at a time
+    void mix(std::uint64_t v) {
+        m_checksum = (m_checksum ^ v) * 0x100000001b3ull;
+    }
+
+    Board m_board;
+    ConeCache m_coneCache;
+    std::shared_ptr<const ConeSet> m_cones;
+    unsigned m_mode;
+    std::size_t m_coneSize;
+    bool m_conesReady;
+    bool m_conesDirty;
+    GridCell m_cursorCell;
+    GridCell m_pointCell;
+    std::uint64_t m_checksum;
+};
+
+// The nearest-rank percentile p of sorted, which must not be empty
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    std::size_t rank = std::size_t(std::ceil(p / 100 * sorted.size()));
+    rank = std::min(std::max<std::size_t>(rank, 1), sorted.size());
+    return sorted[rank - 1];
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s input.rec [output.json]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<InputEvent> events;
+    std::string error;
+    if (!loadInputLog(argv[1], events, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (argc > 2) {
+        out = std::fopen(argv[2], "w");
+        if (!out) {
+            std::perror(argv[2]);
+            return 1;
+        }
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    Session session;
+    session.prepare(events);
+    std::vector<double> latencies[EVENT_TYPES];
+    const Clock::time_point start = Clock::now();
+    for (std::size_t i = 0; i < events.size(); i++) {
+        const Clock::time_point begin = Clock::now();
+        if (!session.handle(events[i])) {
+            std::fprintf(stderr, "%s: bad event %lu\n", argv[1], (unsigned long)i);
+            return 1;
+        }
+        const std::chrono::duration<double, std::micro> took = Clock::now() - begin;
+        latencies[events[i].type].push_back(took.count());
+    }
+    const std::chrono::duration<double> total = Clock::now() - start;
+
+    std::fprintf(out, "{\n  \"log\": \"%s\",\n", argv[1]);
+    std::fprintf(out, "  \"events\": %lu,\n", (unsigned long)events.size());
+    std::fprintf(out, "  \"recorded_seconds\": %.3f,\n", events.empty() ? 0.0 : events.back().time / 1e6);
+    std::fprintf(out, "  \"replay_seconds\": %.6f,\n", total.count());
+    std::fprintf(out, "  \"checksum\": \"%016llx\",\n", (unsigned long long)session.checksum());
+    std::fprintf(out, "  \"latency_us\": [");
+    bool first = true;
+    for (std::size_t t = 0; t < EVENT_TYPES; t++) {
+        std::vector<double> &l = latencies[t];
+        if (l.empty()) {
+            continue;
+        }
+        std::sort(l.begin(), l.end());
+        std::fprintf(out, "%s\n    { \"type\": \"%s\", \"count\": %lu, \"p50\": %.3f, \"p90\": %.3f,"
+                     " \"p99\": %.3f, \"max\": %.3f }",
+                     first ? "" : ",", EVENT_NAMES[t], (unsigned long)l.size(),
+                     percentile(l, 50), percentile(l, 90), percentile(l, 99), l.back());
+        first = false;
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeSolver.cpp
+-----------------------------------------------------------------------------
+*/
+#include "ConeSolver.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+
+// Strict ordering of placements, best first
+static bool better(const ConePlacement &a, const ConePlacement &b)
+{
+    if (a.covered != b.covered) return a.covered > b.covered;
+    if (a.origin.z != b.origin.z) return a.origin.z < b.origin.z;
+    if (a.origin.y != b.origin.y) return a.origin.y < b.origin.y;
+    if (a.origin.x != b.origin.x) return a.origin.x < b.origin.x;
+    return a.direction < b.direction;
+}
+
+// Keeps the best count placements offered to it in a heap with the worst
+// of them on top
+class TopPlacements
+{
+public:
+    explicit TopPlacements(std::size_t count) : m_count(count) {}
+
+    void offer(const ConePlacement &p) {
+        if (m_heap.size() < m_count) {
+            m_heap.push_back(p);
+            std::push_heap(m_heap.begin(), m_heap.end(), better);
+        } else if (m_count > 0 && better(p, m_heap.front())) {
+            std::pop_heap(m_heap.begin(), m_heap.end(), better);
+            m_heap.back() = p;
+            std::push_heap(m_heap.begin(), m_heap.end(), better);
+        }
+    }
+
+    const std::vector<ConePlacement> &placements() const { return m_heap; }
+
+private:
+    std::size_t m_count;
+    std::vector<ConePlacement> m_heap;
+};
+
+//-------------------------------------------------------------------------------------
+template <typename Shape>
+std::uint32_t conesCoveringAll(const AreaSet<Shape> &cones,
+                               const SpatialHash &creatures,
+                               const GridCell &origin)
+{
+    std::uint32_t result = cones.allDirections();
+    std::size_t nearby = 0;
+    creatures.query(origin, cones.radius(), [&](const GridCell &creature) {
+        result &= cones.directionsContaining(creature - origin);
+        nearby++;
+    });
+
+    if (nearby != creatures.size()) {
+        // some creature is out of reach of every cone
+        return 0;
+    }
+    return result;
+}
+
+template <typename Shape>
+std::uint32_t conesCoveringAll(const AreaSet<Shape> &cones,
+                               const SpatialHash &creatures,
+                               const LineOfEffect &visible)
+{
+    const GridCell &origin = visible.origin();
+    std::uint32_t result = cones.allDirections();
+    std::size_t nearby = 0;
+    creatures.query(origin, cones.radius(), [&](const GridCell &creature) {
+        const GridCell offset = creature - origin;
+        result &= visible.visible(offset) ? cones.directionsContaining(offset) : 0;
+        nearby++;
+    });
+
+    if (nearby != creatures.size()) {
+        return 0;
+    }
+    return result;
+}
+
+// Both findBestCones(), with line of effect through walls if there are
+// shadows
+template <typename Shape>
+static std::vector<ConePlacement> findBest(const AreaSet<Shape> &cones,
+                                           const SpatialHash &targets,
+                                           const SpatialHash &allies,
+                                           const GridCell &lo, const GridCell &hi,
+                                           std::size_t count,
+                                           const std::shared_ptr<const ShadowTable> &shadows,
+                                           const OccupancyGrid &walls)
+{
+    std::vector<ConePlacement> result;
+    if (hi.x < lo.x || hi.y < lo.y || hi.z < lo.z || count == 0) {
+        return result;
+    }
+
+    std::size_t nx = hi.x - lo.x + 1;
+    std::size_t ny = hi.y - lo.y + 1;
+    std::size_t nz = hi.z - lo.z + 1;
+    std::size_t dirs = cones.size();
+
+    // The workers share the walls through a window, and each keeps its own
+    // line of effect
+    const int r = cones.radius();
+    const OccupancyGrid::Window window(walls, GridCell(lo.x - r, lo.y - r, lo.z - r),
+                                       GridCell(hi.x + r, hi.y + r, hi.z + r));
+    std::vector<std::unique_ptr<LineOfEffect> > sight(parallelWorkerCount());
+    if (shadows) {
+        for (std::unique_ptr<LineOfEffect> &s : sight) {
+            s.reset(new LineOfEffect(shadows));
+        }
+    }
+
+    std::vector<TopPlacements> best(parallelWorkerCount(), TopPlacements(count));
+    parallelFor(nx * ny * nz, 256, [&](unsigned worker, std::size_t begin, std::size_t end) {
+        std::size_t covered[32];
+        LineOfEffect *visible = sight[worker].get();
+        for (std::size_t i = begin; i < end; i++) {
+            GridCell origin(lo.x + int(i % nx),
+                            lo.y + int(i / nx % ny),
+                            lo.z + int(i / nx / ny));
+
+            // nothing to look up from origins with no wall near them
+            const LineOfEffect *blocked = nullptr;
+            if (visible) {
+                visible->reset(origin, window);
+                blocked = visible->wallCount() ? visible : nullptr;
+            }
+
+            std::fill(covered, covered + dirs, 0);
+            std::uint32_t any = 0;
+            targets.query(origin, cones.radius(), [&](const GridCell &target) {
+                const GridCell offset = target - origin;
+                std::uint32_t mask = !blocked || blocked->visible(offset)
+                                     ? cones.directionsContaining(offset) : 0;
+                any |= mask;
+                for (std::size_t d = 0; d < dirs; d++) {
+                    covered[d] += (mask >> d) & 1;
+                }
+            });
+            if (!any) {
+                continue;
+            }
+
+            allies.query(origin, cones.radius(), [&](const GridCell &ally) {
+                const GridCell offset = ally - origin;
+                if (!blocked || blocked->visible(offset)) {
+                    any &= ~cones.directionsContaining(offset);
+                }
+            });
+
+            for (std::size_t d = 0; d < dirs; d++) {
+                if ((any >> d) & 1) {
+                    ConePlacement p;
+                    p.origin = origin;
+                    p.direction = d;
+                    p.covered = covered[d];
+                    best[worker].offer(p);
+                }
+            }
+        }
+    });
+
+    for (const TopPlacements &b : best) {
+        result.insert(result.end(), b.placements().begin(), b.placements().end());
+    }
+    std::sort(result.begin(), result.end(), better);
+    if (result.size() > count) {
+        result.resize(count);
+    }
+    return result;
+}
+
+template <typename Shape>
+std::vector<ConePlacement> findBestCones(const AreaSet<Shape> &cones,
+                                         const SpatialHash &targets,
+                                         const SpatialHash &allies,
+                                         const GridCell &lo, const GridCell &hi,
+                                         std::size_t count)
+{
+    return findBest(cones, targets, allies, lo, hi, count, nullptr, OccupancyGrid());
+}
+
+template <typename Shape>
+std::vector<ConePlacement> findBestCones(const AreaSet<Shape> &cones,
+                                         const SpatialHash &targets,
+                                         const SpatialHash &allies,
+                                         const GridCell &lo, const GridCell &hi,
+                                         std::size_t count,
+                                         const std::shared_ptr<const ShadowTable> &shadows,
+                                         const OccupancyGrid &walls)
+{
+    return findBest(cones, targets, allies, lo, hi, count, shadows, walls);
+}
+
+// The solver is built once per shape
+#define INSTANTIATE_SOLVER(Shape) \
+    template std::uint32_t conesCoveringAll(const AreaSet<Shape> &, const SpatialHash &, \
+                                            const GridCell &); \
+    template std::uint32_t conesCoveringAll(const AreaSet<Shape> &, const SpatialHash &, \
+                                            const LineOfEffect &); \
+    template std::vector<ConePlacement> findBestCones(const AreaSet<Shape> &, const SpatialHash &, \
+                                                      const SpatialHash &, const GridCell &, \
+                                                      const GridCell &, std::size_t); \
+    template std::vector<ConePlacement> findBestCones(const AreaSet<Shape> &, const SpatialHash &, \
+                                                      const SpatialHash &, const GridCell &, \
+                                                      const GridCell &, std::size_t, \
+                                                      const std::shared_ptr<const ShadowTable> &, \
+                                                      const OccupancyGrid &);
+
+INSTANTIATE_SOLVER(ConeShape)
+INSTANTIATE_SOLVER(BurstShape)
+INSTANTIATE_SOLVER(LineShape)
+INSTANTIATE_SOLVER(CylinderShape)
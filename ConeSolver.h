@@ -0,0 +1,63 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeSolver.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __ConeSolver_h_
+#define __ConeSolver_h_
+
+#include "ConeTemplate.h"
+#include "LineOfEffect.h"
+#include "SpatialHash.h"
+
+#include <vector>
+
+// An area origin and direction (an index into its AreaSet), with the
+// number of targets it covers
+struct ConePlacement
+{
+    GridCell origin;
+    std::size_t direction;
+    std::size_t covered;
+};
+
+// Bitmask of the directions whose area, placed at origin, covers every
+// creature. Only the creatures within reach of origin are visited.
+template <typename Shape>
+std::uint32_t conesCoveringAll(const AreaSet<Shape> &cones,
+                               const SpatialHash &creatures,
+                               const GridCell &origin);
+
+// As above, from visible.origin(), but only creatures with line of effect
+// from the origin count as covered. visible must have the same radius as
+// cones.
+template <typename Shape>
+std::uint32_t conesCoveringAll(const AreaSet<Shape> &cones,
+                               const SpatialHash &creatures,
+                               const LineOfEffect &visible);
+
+// Searches every origin in the box [lo, hi] and every direction of cones,
+// and returns the best count placements, most targets covered first. Ties
+// are broken by origin then direction, so the result does not depend on
+// how the work was split. Placements covering an ally, or no target at
+// all, are left out. The origins are shared out across every core.
+template <typename Shape>
+std::vector<ConePlacement> findBestCones(const AreaSet<Shape> &cones,
+                                         const SpatialHash &targets,
+                                         const SpatialHash &allies,
+                                         const GridCell &lo, const GridCell &hi,
+                                         std::size_t count);
+
+// As above, but a target or ally only counts as covered from an origin it
+// has line of effect from, through walls. shadows must have the same
+// radius as cones.
+template <typename Shape>
+std::vector<ConePlacement> findBestCones(const AreaSet<Shape> &cones,
+                                         const SpatialHash &targets,
+                                         const SpatialHash &allies,
+                                         const GridCell &lo, const GridCell &hi,
+                                         std::size_t count,
+                                         const std::shared_ptr<const ShadowTable> &shadows,
+                                         const OccupancyGrid &walls);
+
+#endif // #ifndef __ConeSolver_h_
@@ -0,0 +1,165 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeTemplate.cpp
+-----------------------------------------------------------------------------
+*/
+#include "ConeTemplate.h"
+
+//-------------------------------------------------------------------------------------
+static const std::vector<GridCell> make_cases() {
+    std::vector<GridCell> v;
+    for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+            for (int z = -1; z <= 1; z++) {
+                v.push_back(GridCell(x, y, z));
+            }
+        }
+    }
+
+    // remove the {0, 0, 0} case
+    v.erase(std::find(v.begin(), v.end(), GridCell(0, 0, 0)));
+    return v;
+}
+
+const std::vector<GridCell> CONE_CASES = make_cases();
+
+//-------------------------------------------------------------------------------------
+template <typename Shape>
+AreaTemplate<Shape>::AreaTemplate(const GridCell &dir, int radius)
+    : m_dir(dir),
+      m_radius(radius),
+      m_extent(2 * radius + 1)
+{
+    m_mask.resize((std::size_t(m_extent) * m_extent * m_extent + 63) / 64);
+
+    // The steps the walk may take never change, so pick them out once
+    // instead of testing all of CONE_CASES at every cell
+    GridCell steps[26];
+    std::size_t stepCount = 0;
+    for (const GridCell &c : CONE_CASES) {
+        if (Shape::step(c, m_dir)) {
+            steps[stepCount++] = c;
+        }
+    }
+
+    // Breadth first walk out from the origin. m_cells doubles as the work
+    // list and the mask as the visited set, so every cell is expanded once.
+    set(GridCell(0, 0, 0));
+    for (std::size_t next = 0; next < m_cells.size(); next++) {
+        GridCell pos = m_cells[next];
+        for (std::size_t i = 0; i < stepCount; i++) {
+            GridCell pNext = pos + steps[i];
+            if (Shape::includes(pNext, m_radius) && !contains(pNext)) {
+                set(pNext);
+            }
+        }
+    }
+}
+
+template <typename Shape>
+void AreaTemplate<Shape>::set(const GridCell &offset)
+{
+    std::size_t i = (std::size_t(offset.z + m_radius) * m_extent + (offset.y + m_radius)) * m_extent
+            + (offset.x + m_radius);
+    m_mask[i >> 6] |= std::uint64_t(1) << (i & 63);
+    m_cells.push_back(offset);
+}
+
+template <typename Shape>
+void AreaTemplate<Shape>::coveredCells(const GridCell &origin, std::vector<GridCell> &out) const
+{
+    for (const GridCell &c : m_cells) {
+        out.push_back(origin + c);
+    }
+}
+
+//-------------------------------------------------------------------------------------
+template <typename Shape>
+OrientedArea<Shape>::OrientedArea(const AreaTemplate<Shape> &canonical, const GridSymmetry &symmetry)
+    : m_template(&canonical),
+      m_symmetry(symmetry),
+      m_dir(symmetry.apply(canonical.direction()))
+{
+}
+
+template <typename Shape>
+void OrientedArea<Shape>::coveredCells(const GridCell &origin, std::vector<GridCell> &out) const
+{
+    for (const GridCell &c : m_template->cells()) {
+        out.push_back(origin + m_symmetry.apply(c));
+    }
+}
+
+//-------------------------------------------------------------------------------------
+template <typename Shape>
+AreaSet<Shape>::AreaSet(int radius)
+    : m_radius(radius),
+      m_extent(2 * radius + 1)
+{
+    if (!Shape::DIRECTED) {
+        // one template, which every direction would look the same as
+        const GridSymmetry identity = { { 0, 1, 2 }, { 1, 1, 1 } };
+        m_templates.push_back(AreaTemplate<Shape>(GridCell(0, 0, 0), radius));
+        m_areas.push_back(OrientedArea<Shape>(m_templates[0], identity));
+    } else {
+        // The face, edge and corner directions. Template k faces along the
+        // first k + 1 axes.
+        m_templates.reserve(3);
+        m_templates.push_back(AreaTemplate<Shape>(GridCell(1, 0, 0), radius));
+        m_templates.push_back(AreaTemplate<Shape>(GridCell(1, 1, 0), radius));
+        m_templates.push_back(AreaTemplate<Shape>(GridCell(1, 1, 1), radius));
+
+        m_areas.reserve(CONE_CASES.size());
+        for (const GridCell &dir : CONE_CASES) {
+            // Send the canonical template's leading axes to the non-zero
+            // axes of dir, with their signs, and the rest to the zero axes
+            const int v[3] = { dir.x, dir.y, dir.z };
+            GridSymmetry symmetry;
+            int used = 0;
+            for (int i = 0; i < 3; i++) {
+                if (v[i] != 0) {
+                    symmetry.axis[i] = used++;
+                    symmetry.sign[i] = v[i];
+                }
+            }
+            const int nonZero = used;
+            for (int i = 0; i < 3; i++) {
+                if (v[i] == 0) {
+                    symmetry.axis[i] = used++;
+                    symmetry.sign[i] = 1;
+                }
+            }
+
+            m_areas.push_back(OrientedArea<Shape>(m_templates[nonZero - 1], symmetry));
+        }
+    }
+
+    m_directions.resize(std::size_t(m_extent) * m_extent * m_extent);
+    for (std::size_t i = 0; i < m_areas.size(); i++) {
+        for (std::size_t j = 0; j < m_areas[i].cellCount(); j++) {
+            GridCell c = m_areas[i].cell(j);
+            std::size_t cell = (std::size_t(c.z + m_radius) * m_extent + (c.y + m_radius)) * m_extent
+                    + (c.x + m_radius);
+            m_directions[cell] |= std::uint32_t(1) << i;
+        }
+    }
+}
+
+template <typename Shape>
+void AreaSet<Shape>::coveredCells(const GridCell &origin, std::size_t dir, std::vector<GridCell> &out) const
+{
+    m_areas[dir].coveredCells(origin, out);
+}
+
+template class AreaTemplate<ConeShape>;
+template class AreaTemplate<BurstShape>;
+template class AreaTemplate<LineShape>;
+template class AreaTemplate<CylinderShape>;
+template class OrientedArea<ConeShape>;
+template class OrientedArea<BurstShape>;
+template class OrientedArea<LineShape>;
+template class OrientedArea<CylinderShape>;
+template class AreaSet<ConeShape>;
+template class AreaSet<BurstShape>;
+template class AreaSet<LineShape>;
+template class AreaSet<CylinderShape>;
@@ -0,0 +1,161 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeTemplate.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __ConeTemplate_h_
+#define __ConeTemplate_h_
+
+#include "AreaShapes.h"
+
+#include <cstdint>
+#include <vector>
+
+// Every direction a cone can face, in cells, excluding {0, 0, 0}
+extern const std::vector<GridCell> CONE_CASES;
+
+// The set of cells covered by an area of a given radius and Shape (see
+// AreaShapes.h), facing one of the 26 grid directions, or {0, 0, 0} for
+// shapes without one, with its origin at {0, 0, 0}.
+//
+// Membership is stored as a bitmask over the (2 * radius + 1)^3 box centred
+// on the origin, so contains() is a bounds check and a bit test.
+template <typename Shape>
+class AreaTemplate
+{
+public:
+    AreaTemplate(const GridCell &dir, int radius);
+
+    // Is the cell at offset (relative to the area origin) inside the area?
+    inline bool contains(const GridCell &offset) const;
+
+    // Appends the cells covered by this area when placed at origin
+    void coveredCells(const GridCell &origin, std::vector<GridCell> &out) const;
+
+    const std::vector<GridCell> &cells() const { return m_cells; }
+    const GridCell &direction() const { return m_dir; }
+    int radius() const { return m_radius; }
+
+private:
+    void set(const GridCell &offset);
+
+    GridCell m_dir;
+    int m_radius;
+    unsigned m_extent;
+
+    std::vector<std::uint64_t> m_mask;
+    std::vector<GridCell> m_cells;
+};
+
+// One of the areas of an AreaSet: a shared canonical template seen through
+// the grid symmetry that turns it to face direction()
+template <typename Shape>
+class OrientedArea
+{
+public:
+    OrientedArea(const AreaTemplate<Shape> &canonical, const GridSymmetry &symmetry);
+
+    bool contains(const GridCell &offset) const { return m_template->contains(m_symmetry.invert(offset)); }
+
+    std::size_t cellCount() const { return m_template->cells().size(); }
+    GridCell cell(std::size_t i) const { return m_symmetry.apply(m_template->cells()[i]); }
+
+    // Appends the cells covered by this area when placed at origin
+    void coveredCells(const GridCell &origin, std::vector<GridCell> &out) const;
+
+    const GridCell &direction() const { return m_dir; }
+    int radius() const { return m_template->radius(); }
+
+private:
+    const AreaTemplate<Shape> *m_template;
+    GridSymmetry m_symmetry;
+    GridCell m_dir;
+};
+
+// All the areas of one Shape and radius: 26 indexed like CONE_CASES for
+// directed shapes, or a single one for the others
+//
+// Under the symmetries of the cube every direction is a face, an edge or a
+// corner of it, so only those three templates are generated. The others
+// are views of them through an axis permutation and sign flips.
+//
+// Alongside the templates it keeps a table over the template box holding,
+// for each offset, a bitmask of the directions whose area covers it.
+// Finding every area that covers a cell is then a single lookup.
+template <typename Shape>
+class AreaSet
+{
+public:
+    explicit AreaSet(int radius);
+
+    // The areas point into m_templates, so a set stays where it was built
+    AreaSet(const AreaSet &) = delete;
+    AreaSet &operator=(const AreaSet &) = delete;
+
+    std::size_t size() const { return m_areas.size(); }
+    const OrientedArea<Shape> &operator[](std::size_t i) const { return m_areas[i]; }
+    int radius() const { return m_radius; }
+
+    // Bitmask with a bit set for every direction
+    std::uint32_t allDirections() const { return (std::uint32_t(1) << m_areas.size()) - 1; }
+
+    // Bit i is set if area i covers the cell at offset from the area origin
+    inline std::uint32_t directionsContaining(const GridCell &offset) const;
+
+    // Appends the cells covered by area dir when placed at origin
+    void coveredCells(const GridCell &origin, std::size_t dir, std::vector<GridCell> &out) const;
+
+private:
+    int m_radius;
+    unsigned m_extent;
+    std::vector<AreaTemplate<Shape> > m_templates;
+    std::vector<OrientedArea<Shape> > m_areas;
+    std::vector<std::uint32_t> m_directions;
+};
+
+typedef AreaTemplate<ConeShape> ConeTemplate;
+typedef OrientedArea<ConeShape> OrientedCone;
+typedef AreaSet<ConeShape> ConeSet;
+
+// Built once per shape in ConeTemplate.cpp
+extern template class AreaTemplate<ConeShape>;
+extern template class AreaTemplate<BurstShape>;
+extern template class AreaTemplate<LineShape>;
+extern template class AreaTemplate<CylinderShape>;
+extern template class OrientedArea<ConeShape>;
+extern template class OrientedArea<BurstShape>;
+extern template class OrientedArea<LineShape>;
+extern template class OrientedArea<CylinderShape>;
+extern template class AreaSet<ConeShape>;
+extern template class AreaSet<BurstShape>;
+extern template class AreaSet<LineShape>;
+extern template class AreaSet<CylinderShape>;
+
+template <typename Shape>
+bool AreaTemplate<Shape>::contains(const GridCell &offset) const
+{
+    unsigned x = offset.x + m_radius;
+    unsigned y = offset.y + m_radius;
+    unsigned z = offset.z + m_radius;
+    if (x >= m_extent || y >= m_extent || z >= m_extent) {
+        return false;
+    }
+
+    std::size_t i = (z * m_extent + y) * m_extent + x;
+    return (m_mask[i >> 6] >> (i & 63)) & 1;
+}
+
+template <typename Shape>
+std::uint32_t AreaSet<Shape>::directionsContaining(const GridCell &offset) const
+{
+    unsigned x = offset.x + m_radius;
+    unsigned y = offset.y + m_radius;
+    unsigned z = offset.z + m_radius;
+    if (x >= m_extent || y >= m_extent || z >= m_extent) {
+        return 0;
+    }
+
+    return m_directions[(z * m_extent + y) * m_extent + x];
+}
+
+#endif // #ifndef __ConeTemplate_h_
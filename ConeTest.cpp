@@ -0,0 +1,504 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ConeTest.cpp
+-----------------------------------------------------------------------------
+
+Headless self-checks for the cone engine. Each fast path is compared with
+the plain computation it stands in for, over random input, and every
+mismatch is counted:
+
+    ConeTest
+
+One line is printed per check, and the exit status is non-zero if any
+failed, so ctest can run it.
+*/
+#include "Board.h"
+#include "ConeCoverage.h"
+#include "ConeSolver.h"
+#include "ConeTemplate.h"
+#include "CoverageMap.h"
+#include "GridKernels.h"
+#include "LineOfEffect.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+static int g_failed;
+
+// Prints the outcome of a check that found mismatches out of cases
+static void report(const std::string &name, long mismatches, long cases)
+{
+    std::printf("%-4s %s: %ld of %ld cases differ\n", mismatches ? "FAIL" : "ok",
+                name.c_str(), mismatches, cases);
+    if (mismatches) {
+        g_failed++;
+    }
+}
+
+// The batch kernels against distance3() and within45(), with every set of
+// kernels the CPU can run. Offsets reach up to the 2^24 the batches are
+// exact to, and the counts aren't multiples of the vector widths, so the
+// scalar tails are covered too.
+static void checkGridKernels(std::mt19937 &rng)
+{
+    const int extent = (1 << 23) - 1;
+    std::uniform_int_distribution<int> far(-extent, extent);
+    std::uniform_int_distribution<int> near(-20, 20);
+
+    CellArrays cells;
+    std::vector<GridCell> origins;
+    for (int i = 0; i < 20003; i++) {
+        cells.push_back(i % 2 ? GridCell(far(rng), far(rng), far(rng))
+                              : GridCell(near(rng), near(rng), near(rng)));
+    }
+    origins.push_back(GridCell(0, 0, 0));
+    origins.push_back(GridCell(near(rng), near(rng), near(rng)));
+    origins.push_back(GridCell(far(rng), far(rng), far(rng)));
+
+    const std::string best = gridKernelName();
+    std::vector<int> distances(cells.size());
+    std::vector<std::uint8_t> inside(cells.size());
+    for (const char *kernels : { "scalar", "sse4.1", "avx2" }) {
+        if (!useGridKernels(kernels)) {
+            std::printf("skip %s kernels: not supported here\n", kernels);
+            continue;
+        }
+
+        long distanceMismatches = 0, distanceCases = 0;
+        long within45Mismatches = 0, within45Cases = 0;
+        for (const GridCell &origin : origins) {
+            distance3Batch(cells, origin, &distances[0]);
+            for (std::size_t i = 0; i < cells.size(); i++) {
+                distanceMismatches += distances[i] != distance3(cells[i] - origin);
+            }
+            distanceCases += cells.size();
+
+            // the array form, over a count that leaves a tail
+            const std::size_t n = cells.size() - 2;
+            distance3Batch(&cells.x[0], &cells.y[0], &cells.z[0], n, origin, &distances[0]);
+            for (std::size_t i = 0; i < n; i++) {
+                distanceMismatches += distances[i] != distance3(cells[i] - origin);
+            }
+            distanceCases += n;
+
+            for (const GridCell &dir : CONE_CASES) {
+                within45Batch(cells, origin, dir, &inside[0]);
+                for (std::size_t i = 0; i < cells.size(); i++) {
+                    within45Mismatches += inside[i] != within45(cells[i] - origin, dir);
+                }
+                within45Cases += cells.size();
+            }
+        }
+        report(std::string("distance3Batch, ") + kernels, distanceMismatches, distanceCases);
+        report(std::string("within45Batch, ") + kernels, within45Mismatches, within45Cases);
+    }
+    useGridKernels(best.c_str());
+}
+
+// The areas of set built one at a time, without the cube symmetries or
+// the direction table, for the fast paths to be checked against
+template <typename Shape>
+static std::vector<AreaTemplate<Shape> > directAreas(const AreaSet<Shape> &set)
+{
+    std::vector<AreaTemplate<Shape> > areas;
+    for (std::size_t d = 0; d < set.size(); d++) {
+        areas.push_back(AreaTemplate<Shape>(set[d].direction(), set.radius()));
+    }
+    return areas;
+}
+
+static std::tuple<int, int, int> key(const GridCell &c)
+{
+    return std::make_tuple(c.x, c.y, c.z);
+}
+
+// Random distinct cells in the box [-extent, extent] along x and z and
+// [0, height) along y
+static std::vector<GridCell> randomCells(std::mt19937 &rng, std::size_t count, int extent, int height)
+{
+    std::uniform_int_distribution<int> across(-extent, extent), up(0, height - 1);
+    std::set<std::tuple<int, int, int> > taken;
+    std::vector<GridCell> cells;
+    while (cells.size() < count) {
+        const GridCell c(across(rng), up(rng), across(rng));
+        if (taken.insert(key(c)).second) {
+            cells.push_back(c);
+        }
+    }
+    return cells;
+}
+
+// Every area of an AreaSet, seen through its symmetry and through the
+// direction table, against the same area built directly
+template <typename Shape>
+static void checkAreaSets(const char *shape)
+{
+    long mismatches = 0, cases = 0;
+    for (int radius = 0; radius <= 12; radius++) {
+        const AreaSet<Shape> set(radius);
+        const std::vector<AreaTemplate<Shape> > direct = directAreas(set);
+        const int r = radius + 1;
+        for (int z = -r; z <= r; z++) {
+            for (int y = -r; y <= r; y++) {
+                for (int x = -r; x <= r; x++) {
+                    const GridCell offset(x, y, z);
+                    const std::uint32_t mask = set.directionsContaining(offset);
+                    for (std::size_t d = 0; d < set.size(); d++) {
+                        const bool inside = direct[d].contains(offset);
+                        mismatches += set[d].contains(offset) != inside;
+                        mismatches += bool((mask >> d) & 1) != inside;
+                        cases += 2;
+                    }
+                }
+            }
+        }
+        for (std::size_t d = 0; d < set.size(); d++) {
+            mismatches += set[d].cellCount() != direct[d].cells().size();
+            cases++;
+        }
+    }
+    report(std::string("AreaSet<") + shape + "> against direct templates", mismatches, cases);
+}
+
+// offsetWithin() between cells at the ends of the int range, as ConeBatch
+// reads them: a creature a few cells from the origin is found at that
+// offset, and one at the far end of the range, whose offset overflows an
+// int, is out of reach
+static void checkOffsets(std::mt19937 &rng)
+{
+    const int ends[] = { INT_MIN, INT_MIN + 1, -1, 0, 1, INT_MAX - 1, INT_MAX };
+    const int radius = 6;
+    std::uniform_int_distribution<int> end(0, sizeof(ends) / sizeof(ends[0]) - 1), near(-8, 8);
+    long mismatches = 0, cases = 0;
+    for (int i = 0; i < 100000; i++) {
+        const GridCell origin(ends[end(rng)], ends[end(rng)], ends[end(rng)]);
+        const long long step[3] = { near(rng), near(rng), near(rng) };
+        const long long cell[3] = { origin.x + step[0], origin.y + step[1], origin.z + step[2] };
+        GridCell offset;
+        if (std::all_of(cell, cell + 3, [](long long c) { return c >= INT_MIN && c <= INT_MAX; })) {
+            const bool within = std::all_of(step, step + 3, [](long long d) { return std::llabs(d) <= radius; });
+            const GridCell creature = GridCell(int(cell[0]), int(cell[1]), int(cell[2]));
+            const bool found = offsetWithin(origin, creature, radius, offset);
+            mismatches += found != within;
+            mismatches += found && offset != GridCell(int(step[0]), int(step[1]), int(step[2]));
+            cases += 2;
+        }
+
+        // the same axis at the other end of the range
+        const GridCell far(origin.x < 0 ? INT_MAX : INT_MIN, origin.y, origin.z);
+        mismatches += offsetWithin(origin, far, radius, offset);
+        cases++;
+    }
+    report("offsetWithin() at the ends of the int range", mismatches, cases);
+}
+
+// ConeCoverage stepped along a random walk against counting from scratch
+// at every origin, and coveringAll() against conesCoveringAll()
+static void checkCoverageSteps(std::mt19937 &rng)
+{
+    long mismatches = 0, cases = 0;
+    std::uniform_int_distribution<int> unit(-1, 1);
+    for (int radius : { 1, 3, 6 }) {
+        const std::shared_ptr<const ConeSet> cones = std::make_shared<const ConeSet>(radius);
+        SpatialHash creatures;
+        OccupancyGrid cells;
+        for (const GridCell &c : randomCells(rng, 300, 10, 4)) {
+            creatures.insert(c);
+            cells.set(c);
+        }
+
+        const OccupancyGrid walls;
+        LineOfEffect visible(std::make_shared<const ShadowTable>(radius));
+        GridCell origin(0, 0, 0);
+        visible.reset(origin, walls);
+        ConeCoverage stepped(cones);
+        stepped.reset(creatures, visible);
+
+        for (int i = 0; i < 2000; i++) {
+            const GridCell step(unit(rng), unit(rng), unit(rng));
+            const GridCell next = origin + step;
+            if (std::abs(next.x) > 12 || std::abs(next.y) > 6 || std::abs(next.z) > 12) {
+                continue;
+            }
+            const bool moved = stepped.step(next, cells);
+            cases++;
+            if (moved != (step != GridCell(0, 0, 0))) {
+                mismatches++;
+                continue;
+            }
+            origin = next;
+
+            visible.reset(origin, walls);
+            ConeCoverage counted(cones);
+            counted.reset(creatures, visible);
+            for (std::size_t d = 0; d < cones->size(); d++) {
+                mismatches += stepped.covered(d) != counted.covered(d);
+            }
+            mismatches += stepped.coveringAll(creatures.size()) != conesCoveringAll(*cones, creatures, origin);
+            cases += cones->size() + 1;
+        }
+    }
+    report("ConeCoverage steps against recounts", mismatches, cases);
+}
+
+// LineOfEffect kept up to date a wall at a time against recomputing it,
+// and the cells reported as flipped against those that changed
+static void checkLineOfEffect(std::mt19937 &rng)
+{
+    long mismatches = 0, cases = 0;
+    for (int radius : { 3, 6 }) {
+        const std::shared_ptr<const ShadowTable> table = std::make_shared<const ShadowTable>(radius);
+        const GridCell origin(5, 0, -7);
+        std::uniform_int_distribution<int> across(-radius - 1, radius + 1);
+
+        OccupancyGrid walls;
+        LineOfEffect updated(table);
+        updated.reset(origin, walls);
+        LineOfEffect before(table);
+        before.reset(origin, walls);
+        for (int i = 0; i < 300; i++) {
+            const GridCell wall = origin + GridCell(across(rng), across(rng), across(rng));
+            std::set<std::tuple<int, int, int> > flipped;
+            auto flip = [&flipped](const GridCell &offset) {
+                flipped.insert(key(offset));
+            };
+            if (walls.test(wall)) {
+                walls.reset(wall);
+                updated.removeWall(wall, flip);
+            } else {
+                walls.set(wall);
+                updated.addWall(wall, flip);
+            }
+
+            LineOfEffect after(table);
+            after.reset(origin, walls);
+            mismatches += updated.wallCount() != after.wallCount();
+            cases++;
+            for (int z = -radius; z <= radius; z++) {
+                for (int y = -radius; y <= radius; y++) {
+                    for (int x = -radius; x <= radius; x++) {
+                        const GridCell offset(x, y, z);
+                        const bool changed = before.visible(offset) != after.visible(offset);
+                        mismatches += updated.visible(offset) != after.visible(offset);
+                        mismatches += changed != (flipped.count(key(offset)) != 0);
+                        cases += 2;
+                    }
+                }
+            }
+            before.reset(origin, walls);
+        }
+    }
+    report("LineOfEffect wall updates against resets", mismatches, cases);
+}
+
+// The direction bitmask the board evaluates, as walls come and go and the
+// origin moves, against conesCoveringAll() from a fresh line of effect.
+// Every troll must be covered for a direction to count, so each round
+// keeps to a few trolls close to the origin.
+static void checkBoard(std::mt19937 &rng)
+{
+    long mismatches = 0, cases = 0, covering = 0;
+    const int radius = 3;
+    const std::shared_ptr<const ConeSet> cones = std::make_shared<const ConeSet>(radius);
+    LineOfEffect visible(std::make_shared<const ShadowTable>(radius));
+    std::uniform_int_distribution<int> near(-2, 2), up(0, 2), unit(-1, 1), trolls(1, 3), action(0, 9);
+
+    Board board;
+    for (int round = 0; round < 100; round++) {
+        board.clear();
+        GridCell origin(0, 0, 0);
+        for (int i = trolls(rng); i > 0; i--) {
+            board.addCreature(GridCell(near(rng), up(rng), near(rng)), TrollCreature);
+        }
+
+        for (int i = 0; i < 40; i++) {
+            const GridCell cell(near(rng), up(rng), near(rng));
+            bool changed;
+            switch (action(rng)) {
+            case 0:
+                board.addCreature(cell, AllyCreature);
+                break;
+            case 1:
+            case 2:
+            case 3:
+                if (board.walls().test(cell)) {
+                    board.removeWall(cell, changed);
+                } else {
+                    board.addWall(cell, changed);
+                }
+                break;
+            default:
+                // steps, which the counts follow a cell at a time
+                origin = origin + GridCell(unit(rng), 0, unit(rng));
+                break;
+            }
+
+            visible.reset(origin, board.walls());
+            const std::uint32_t expected = conesCoveringAll(*cones, board.ogres(), visible);
+            mismatches += board.evaluate(cones, origin) != expected;
+            covering += expected != 0;
+            cases++;
+        }
+    }
+    report("Board::evaluate() against conesCoveringAll()", mismatches, cases);
+    if (covering < cases / 10) {
+        report("Board::evaluate() check reaching covered trolls", 1, 1);
+    }
+}
+
+// findBestCones() against trying every origin and direction with the
+// directly built cones, in the open and with walls in the way
+static void checkSolver(std::mt19937 &rng)
+{
+    long mismatches = 0, cases = 0;
+    for (int run = 0; run < 4; run++) {
+        const int radius = run < 2 ? 1 : 3;
+        const bool walled = run % 2;
+        const ConeSet cones(radius);
+        const std::vector<ConeTemplate> direct = directAreas(cones);
+        const std::shared_ptr<const ShadowTable> shadows = std::make_shared<const ShadowTable>(radius);
+        const std::vector<GridCell> cells = randomCells(rng, 64, 8, 3);
+        SpatialHash targets, allies;
+        OccupancyGrid walls;
+        std::vector<GridCell> targetCells, allyCells;
+        for (std::size_t i = 0; i < 48; i++) {
+            (i % 8 ? targets : allies).insert(cells[i]);
+            (i % 8 ? targetCells : allyCells).push_back(cells[i]);
+        }
+        for (std::size_t i = 48; walled && i < cells.size(); i++) {
+            walls.set(cells[i]);
+        }
+        const GridCell lo(-8 - radius, 0, -8 - radius), hi(8 + radius, 0, 8 + radius);
+
+        std::vector<ConePlacement> all;
+        LineOfEffect visible(shadows);
+        for (int z = lo.z; z <= hi.z; z++) {
+            for (int x = lo.x; x <= hi.x; x++) {
+                const GridCell origin(x, 0, z);
+                visible.reset(origin, walls);
+                for (std::size_t d = 0; d < direct.size(); d++) {
+                    ConePlacement p;
+                    p.origin = origin;
+                    p.direction = d;
+                    p.covered = 0;
+                    for (const GridCell &t : targetCells) {
+                        p.covered += direct[d].contains(t - origin) && visible.visible(t - origin);
+                    }
+                    bool ally = false;
+                    for (const GridCell &a : allyCells) {
+                        ally = ally || (direct[d].contains(a - origin) && visible.visible(a - origin));
+                    }
+                    if (p.covered && !ally) {
+                        all.push_back(p);
+                    }
+                }
+            }
+        }
+        std::sort(all.begin(), all.end(), [](const ConePlacement &a, const ConePlacement &b) {
+            if (a.covered != b.covered) return a.covered > b.covered;
+            if (a.origin.z != b.origin.z) return a.origin.z < b.origin.z;
+            if (a.origin.y != b.origin.y) return a.origin.y < b.origin.y;
+            if (a.origin.x != b.origin.x) return a.origin.x < b.origin.x;
+            return a.direction < b.direction;
+        });
+
+        for (std::size_t count : { std::size_t(1), std::size_t(20), all.size() + 1 }) {
+            const std::vector<ConePlacement> best =
+                    walled ? findBestCones(cones, targets, allies, lo, hi, count, shadows, walls)
+                           : findBestCones(cones, targets, allies, lo, hi, count);
+            const std::size_t expected = std::min(count, all.size());
+            mismatches += best.size() != expected;
+            cases++;
+            for (std::size_t i = 0; i < std::min(best.size(), expected); i++) {
+                mismatches += best[i].origin != all[i].origin || best[i].direction != all[i].direction
+                              || best[i].covered != all[i].covered;
+                cases++;
+            }
+        }
+    }
+    report("findBestCones() against brute force, with and without walls", mismatches, cases);
+}
+
+// ConeCoverageMap, counted from scratch and then a creature at a time,
+// against counting every origin with the directly built cones
+static void checkCoverageMap(std::mt19937 &rng)
+{
+    long mismatches = 0, cases = 0;
+    const int radius = 3;
+    const std::shared_ptr<const ConeSet> cones = std::make_shared<const ConeSet>(radius);
+    const std::vector<ConeTemplate> direct = directAreas(*cones);
+    const GridCell corner(-12, 0, -12);
+    const int width = 25, depth = 25;
+
+    std::vector<GridCell> placed = randomCells(rng, 100, 12, 3);
+    const std::vector<GridCell> later(placed.end() - 20, placed.end());
+    placed.resize(placed.size() - 20);
+    SpatialHash creatures;
+    for (const GridCell &c : placed) {
+        creatures.insert(c);
+    }
+
+    ConeCoverageMap map(cones);
+    map.reset(creatures, corner, width, depth);
+    for (std::size_t step = 0; step <= later.size(); step++) {
+        if (step > 0) {
+            GridCell lo, hi;
+            map.add(later[step - 1], lo, hi);
+            placed.push_back(later[step - 1]);
+        }
+        if (step % 5) {
+            continue;
+        }
+
+        unsigned peak = 0;
+        for (int z = 0; z < depth; z++) {
+            for (int x = 0; x < width; x++) {
+                const GridCell origin = corner + GridCell(x, 0, z);
+                unsigned best = 0;
+                for (const ConeTemplate &cone : direct) {
+                    unsigned covered = 0;
+                    for (const GridCell &c : placed) {
+                        covered += cone.contains(c - origin);
+                    }
+                    best = std::max(best, covered);
+                }
+                peak = std::max(peak, best);
+                mismatches += map.best(x, z) != best;
+                cases++;
+            }
+        }
+        mismatches += map.peak() != peak;
+        cases++;
+    }
+    report("ConeCoverageMap against brute force", mismatches, cases);
+}
+
+int main()
+{
+    std::mt19937 rng(42);
+    checkGridKernels(rng);
+    checkAreaSets<ConeShape>("ConeShape");
+    checkAreaSets<BurstShape>("BurstShape");
+    checkAreaSets<LineShape>("LineShape");
+    checkAreaSets<CylinderShape>("CylinderShape");
+    checkOffsets(rng);
+    checkCoverageSteps(rng);
+    checkLineOfEffect(rng);
+    checkBoard(rng);
+    checkSolver(rng);
+    checkCoverageMap(rng);
+
+    if (g_failed) {
+        std::printf("%d checks failed\n", g_failed);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
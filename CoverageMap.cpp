@@ -0,0 +1,133 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    CoverageMap.cpp
+-----------------------------------------------------------------------------
+*/
+#include "CoverageMap.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+//-------------------------------------------------------------------------------------
+template <typename Shape>
+AreaCoverageMap<Shape>::AreaCoverageMap(std::shared_ptr<const AreaSet<Shape> > areas)
+    : m_areas(areas),
+      m_extent(2 * areas->radius() + 1),
+      m_width(0),
+      m_depth(0),
+      m_peak(0)
+{
+    const int r = m_areas->radius();
+    m_lanes.resize(std::size_t(m_extent) * m_extent * m_extent * LANES);
+    std::uint16_t *lanes = &m_lanes[0];
+    for (int z = -r; z <= r; z++) {
+        for (int y = -r; y <= r; y++) {
+            for (int x = -r; x <= r; x++, lanes += LANES) {
+                const std::uint32_t mask = m_areas->directionsContaining(GridCell(x, y, z));
+                for (int d = 0; d < LANES; d++) {
+                    lanes[d] = (mask >> d) & 1;
+                }
+            }
+        }
+    }
+}
+
+template <typename Shape>
+void AreaCoverageMap<Shape>::reset(const SpatialHash &creatures, const GridCell &origin, int width, int depth)
+{
+    m_origin = GridCell(origin.x, 0, origin.z);
+    m_width = std::max(width, 0);
+    m_depth = std::max(depth, 0);
+    m_counts.assign(std::size_t(m_width) * m_depth * LANES, 0);
+    m_best.assign(std::size_t(m_width) * m_depth, 0);
+    m_peak = 0;
+    if (m_width == 0 || m_depth == 0) {
+        return;
+    }
+
+    // Each slice of rows takes the creatures within reach of it, so no two
+    // workers write to the same origin
+    const int r = m_areas->radius();
+    std::vector<std::uint16_t> peaks(parallelWorkerCount(), 0);
+    parallelFor(std::size_t(m_depth), 4, [&](unsigned worker, std::size_t begin, std::size_t end) {
+        const int zBegin = int(begin), zEnd = int(end);
+        creatures.queryBox(GridCell(m_origin.x - r, -r, m_origin.z + zBegin - r),
+                           GridCell(m_origin.x + m_width - 1 + r, r, m_origin.z + zEnd - 1 + r),
+                           [&](const GridCell &creature) {
+            scatter(creature, zBegin, zEnd);
+        });
+        peaks[worker] = std::max(peaks[worker], updateBest(0, zBegin, m_width - 1, zEnd - 1));
+    });
+    m_peak = *std::max_element(peaks.begin(), peaks.end());
+}
+
+template <typename Shape>
+bool AreaCoverageMap<Shape>::add(const GridCell &creature, GridCell &lo, GridCell &hi)
+{
+    const int r = m_areas->radius();
+    const GridCell c = creature - m_origin;
+    lo = GridCell(std::max(c.x - r, 0), 0, std::max(c.z - r, 0));
+    hi = GridCell(std::min(c.x + r, m_width - 1), 0, std::min(c.z + r, m_depth - 1));
+    if (std::abs(creature.y) > r || lo.x > hi.x || lo.z > hi.z) {
+        return false;
+    }
+
+    scatter(creature, lo.z, hi.z + 1);
+    m_peak = std::max(m_peak, updateBest(lo.x, lo.z, hi.x, hi.z));
+    return true;
+}
+
+template <typename Shape>
+void AreaCoverageMap<Shape>::scatter(const GridCell &creature, int zBegin, int zEnd)
+{
+    const int r = m_areas->radius();
+    const GridCell c = creature - m_origin;
+    if (std::abs(c.y) > r) {
+        return;
+    }
+
+    const int x0 = std::max(c.x - r, 0), x1 = std::min(c.x + r, m_width - 1);
+    const int z0 = std::max(c.z - r, zBegin), z1 = std::min(c.z + r, zEnd - 1);
+    for (int z = z0; z <= z1; z++) {
+        // The creature sits at offset c - (x, 0, z) from origin (x, 0, z),
+        // so walking the origins up x walks the offsets down it
+        const std::size_t box = (std::size_t(c.z - z + r) * m_extent + (c.y + r)) * m_extent;
+        const std::uint16_t *lanes = &m_lanes[(box + (c.x - x0 + r)) * LANES];
+        std::uint16_t *counts = &m_counts[(std::size_t(z) * m_width + x0) * LANES];
+        for (int x = x0; x <= x1; x++, lanes -= LANES, counts += LANES) {
+            // through a local copy, so the compiler can see the two don't
+            // overlap and vectorise the add
+            std::uint16_t add[LANES];
+            std::copy(lanes, lanes + LANES, add);
+            for (int d = 0; d < LANES; d++) {
+                counts[d] += add[d];
+            }
+        }
+    }
+}
+
+template <typename Shape>
+std::uint16_t AreaCoverageMap<Shape>::updateBest(int x0, int z0, int x1, int z1)
+{
+    std::uint16_t peak = 0;
+    for (int z = z0; z <= z1; z++) {
+        const std::uint16_t *counts = &m_counts[(std::size_t(z) * m_width + x0) * LANES];
+        std::uint16_t *best = &m_best[std::size_t(z) * m_width + x0];
+        for (int x = x0; x <= x1; x++, counts += LANES, best++) {
+            // unused lanes are always 0
+            std::uint16_t most = 0;
+            for (int d = 0; d < LANES; d++) {
+                most = std::max(most, counts[d]);
+            }
+            *best = most;
+            peak = std::max(peak, most);
+        }
+    }
+    return peak;
+}
+
+template class AreaCoverageMap<ConeShape>;
+template class AreaCoverageMap<BurstShape>;
+template class AreaCoverageMap<LineShape>;
+template class AreaCoverageMap<CylinderShape>;
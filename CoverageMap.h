@@ -0,0 +1,81 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    CoverageMap.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __CoverageMap_h_
+#define __CoverageMap_h_
+
+#include "ConeTemplate.h"
+#include "SpatialHash.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// For every origin on a rectangle of the y = 0 floor, the most creatures
+// any one area of an AreaSet covers from there.
+//
+// The per-direction counts are a convolution of the creatures with each
+// area: every creature adds, to every origin around it, a lane per
+// direction holding 1 if that direction's area covers it. The lanes come
+// from a table over the template box and are added 32 at a time, which
+// the compiler turns into a few vector adds per origin. Lines of effect
+// are not taken into account.
+template <typename Shape>
+class AreaCoverageMap
+{
+public:
+    explicit AreaCoverageMap(std::shared_ptr<const AreaSet<Shape> > areas);
+
+    const AreaSet<Shape> &areas() const { return *m_areas; }
+
+    // The low corner of the rectangle, and its size in cells along x and z
+    const GridCell &origin() const { return m_origin; }
+    int width() const { return m_width; }
+    int depth() const { return m_depth; }
+
+    // Counts the rectangle of width by depth origins from origin from
+    // scratch. Rows of origins are shared out across every core.
+    void reset(const SpatialHash &creatures, const GridCell &origin, int width, int depth);
+
+    // Adds one creature to the counts of the origins around it. The
+    // origins whose best count may have changed are the box [lo, hi], in
+    // map coordinates; returns false if there are none.
+    bool add(const GridCell &creature, GridCell &lo, GridCell &hi);
+
+    // Most creatures covered by one area from origin() + (x, 0, z)
+    std::uint16_t best(int x, int z) const { return m_best[std::size_t(z) * m_width + x]; }
+    // The largest best() over the whole map
+    std::uint16_t peak() const { return m_peak; }
+
+private:
+    static const int LANES = 32;
+
+    // Adds creature to the origins of rows [zBegin, zEnd)
+    void scatter(const GridCell &creature, int zBegin, int zEnd);
+    // Brings best() up to date for the box [lo, hi] of origins, and
+    // returns the largest of them
+    std::uint16_t updateBest(int x0, int z0, int x1, int z1);
+
+    std::shared_ptr<const AreaSet<Shape> > m_areas;
+    unsigned m_extent;
+    // LANES counts for each offset in the template box, x fastest
+    std::vector<std::uint16_t> m_lanes;
+
+    GridCell m_origin;
+    int m_width, m_depth;
+    // LANES counts for each origin, x fastest
+    std::vector<std::uint16_t> m_counts;
+    std::vector<std::uint16_t> m_best;
+    std::uint16_t m_peak;
+};
+
+typedef AreaCoverageMap<ConeShape> ConeCoverageMap;
+
+extern template class AreaCoverageMap<ConeShape>;
+extern template class AreaCoverageMap<BurstShape>;
+extern template class AreaCoverageMap<LineShape>;
+extern template class AreaCoverageMap<CylinderShape>;
+
+#endif // #ifndef __CoverageMap_h_
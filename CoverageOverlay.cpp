@@ -0,0 +1,133 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    CoverageOverlay.cpp
+-----------------------------------------------------------------------------
+*/
+#include "CoverageOverlay.h"
+
+#include <OgreHardwarePixelBuffer.h>
+#include <OgreManualObject.h>
+#include <OgreMaterialManager.h>
+#include <OgreResourceGroupManager.h>
+#include <OgreTechnique.h>
+#include <OgreTextureManager.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Ogre;
+
+static const char *const OVERLAY_TEXTURE = "coverageOverlay";
+static const char *const OVERLAY_MATERIAL = "coverageOverlay";
+
+// Lifts the quad off the floor, as a fraction of a cell, so the grid lines
+// don't flicker through it
+static const Real OVERLAY_HEIGHT = 0.05f;
+
+//-------------------------------------------------------------------------------------
+CoverageOverlay::CoverageOverlay(SceneManager *sceneMgr, Real spacing, int width, int depth)
+    : m_sceneMgr(sceneMgr),
+      m_spacing(spacing),
+      m_width(width),
+      m_depth(depth),
+      m_node(nullptr),
+      m_peak(0)
+{
+    // kept out of General, which may still be loading in the background
+    const String &group = ResourceGroupManager::INTERNAL_RESOURCE_GROUP_NAME;
+    m_texture = TextureManager::getSingleton().createManual(
+                OVERLAY_TEXTURE, group, TEX_TYPE_2D, m_width, m_depth, 0,
+                PF_BYTE_BGRA, TU_DYNAMIC_WRITE_ONLY);
+
+    m_material = MaterialManager::getSingleton().create(OVERLAY_MATERIAL, group);
+    Pass *pass = m_material->getTechnique(0)->getPass(0);
+    pass->setLightingEnabled(false);
+    pass->setSceneBlending(SBT_TRANSPARENT_ALPHA);
+    pass->setDepthWriteEnabled(false);
+    pass->setCullingMode(CULL_NONE);
+    TextureUnitState *unit = pass->createTextureUnitState(OVERLAY_TEXTURE);
+    unit->setTextureFiltering(TFO_NONE);
+    unit->setTextureAddressingMode(TextureUnitState::TAM_CLAMP);
+
+    ManualObject *quad = m_sceneMgr->createManualObject();
+    quad->begin(OVERLAY_MATERIAL, RenderOperation::OT_TRIANGLE_STRIP, group);
+    quad->position(0, 0, 0);
+    quad->textureCoord(0, 0);
+    quad->position(0, 0, m_depth * m_spacing);
+    quad->textureCoord(0, 1);
+    quad->position(m_width * m_spacing, 0, 0);
+    quad->textureCoord(1, 0);
+    quad->position(m_width * m_spacing, 0, m_depth * m_spacing);
+    quad->textureCoord(1, 1);
+    quad->end();
+
+    m_node = m_sceneMgr->getRootSceneNode()->createChildSceneNode();
+    m_node->attachObject(quad);
+    m_node->setVisible(false);
+}
+
+CoverageOverlay::~CoverageOverlay()
+{
+    MovableObject *quad = m_node->getAttachedObject(0);
+    m_node->detachAllObjects();
+    m_sceneMgr->destroyMovableObject(quad);
+    m_sceneMgr->destroySceneNode(m_node);
+    MaterialManager::getSingleton().remove(m_material->getHandle());
+    TextureManager::getSingleton().remove(m_texture->getHandle());
+}
+
+void CoverageOverlay::setVisible(bool visible)
+{
+    m_node->setVisible(visible);
+}
+
+bool CoverageOverlay::isVisible() const
+{
+    return m_node->getAttachedObject(0)->isVisible();
+}
+
+void CoverageOverlay::update(const ConeCoverageMap &map)
+{
+    const GridCell &origin = map.origin();
+    m_node->setPosition(origin.x * m_spacing, OVERLAY_HEIGHT * m_spacing, origin.z * m_spacing);
+    m_peak = map.peak();
+    upload(map, 0, 0, map.width() - 1, map.depth() - 1);
+}
+
+void CoverageOverlay::update(const ConeCoverageMap &map, const GridCell &lo, const GridCell &hi)
+{
+    if (map.peak() != m_peak) {
+        // every texel is shaded against the peak
+        update(map);
+        return;
+    }
+    upload(map, lo.x, lo.z, hi.x, hi.z);
+}
+
+void CoverageOverlay::upload(const ConeCoverageMap &map, int x0, int z0, int x1, int z1)
+{
+    // the texture is fixed in size, so anything beyond it is left out
+    x1 = std::min(x1, m_width - 1);
+    z1 = std::min(z1, m_depth - 1);
+    if (x0 > x1 || z0 > z1) {
+        return;
+    }
+
+    const int w = x1 - x0 + 1, d = z1 - z0 + 1;
+    m_texels.resize(std::size_t(w) * d * 4);
+    uint8 *texel = &m_texels[0];
+    for (int z = z0; z <= z1; z++) {
+        for (int x = x0; x <= x1; x++, texel += 4) {
+            const std::uint16_t n = map.best(x, z);
+            // blue through green to red
+            const Real t = m_peak ? Real(n) / m_peak : 0;
+            texel[0] = uint8(255 * (1 - t));
+            texel[1] = uint8(255 * (1 - std::abs(2 * t - 1)));
+            texel[2] = uint8(255 * t);
+            texel[3] = n ? 128 : 0;
+        }
+    }
+
+    const PixelBox src(w, d, 1, PF_BYTE_BGRA, &m_texels[0]);
+    m_texture->getBuffer()->blitFromMemory(src, Image::Box(x0, z0, x1 + 1, z1 + 1));
+}
@@ -0,0 +1,55 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    CoverageOverlay.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __CoverageOverlay_h_
+#define __CoverageOverlay_h_
+
+#include "CoverageMap.h"
+
+#include <OgreSceneManager.h>
+#include <OgreTexture.h>
+#include <OgreMaterial.h>
+
+#include <vector>
+
+// Draws a ConeCoverageMap on the floor as one quad with a dynamic texture,
+// a texel per cell, shaded from blue for few creatures to red for the
+// map's peak. Cells no cone covers anything from are left clear.
+class CoverageOverlay
+{
+public:
+    // The texture holds maps of up to width by depth cells
+    CoverageOverlay(Ogre::SceneManager *sceneMgr, Ogre::Real spacing, int width, int depth);
+    ~CoverageOverlay();
+
+    CoverageOverlay(const CoverageOverlay &) = delete;
+    CoverageOverlay &operator=(const CoverageOverlay &) = delete;
+
+    void setVisible(bool visible);
+    bool isVisible() const;
+
+    // Uploads the whole of map and moves the quad over it
+    void update(const ConeCoverageMap &map);
+    // Uploads the box [lo, hi] of map, in map coordinates, as returned by
+    // ConeCoverageMap::add(). Everything is uploaded again if the map's
+    // peak has changed since the last upload.
+    void update(const ConeCoverageMap &map, const GridCell &lo, const GridCell &hi);
+
+private:
+    void upload(const ConeCoverageMap &map, int x0, int z0, int x1, int z1);
+
+    Ogre::SceneManager *m_sceneMgr;
+    Ogre::Real m_spacing;
+    int m_width, m_depth;
+    Ogre::TexturePtr m_texture;
+    Ogre::MaterialPtr m_material;
+    Ogre::SceneNode *m_node;
+    // the peak the uploaded texels are shaded against
+    std::uint16_t m_peak;
+    // BGRA texels, reused between uploads
+    std::vector<Ogre::uint8> m_texels;
+};
+
+#endif // #ifndef __CoverageOverlay_h_
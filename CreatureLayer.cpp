@@ -0,0 +1,198 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    CreatureLayer.cpp
+-----------------------------------------------------------------------------
+*/
+#include "CreatureLayer.h"
+
+#include <OgreEntity.h>
+#include <OgreStringConverter.h>
+
+using namespace Ogre;
+
+// The mesh of each kind, or nullptr for Ogre's prefab cube
+static const char *const CREATURE_MESHES[CreatureLayer::KIND_COUNT] = {
+    "ogrehead.mesh",
+    "ogrehead.mesh",
+    nullptr,
+};
+
+static const char *const CREATURE_MATERIALS[CreatureLayer::KIND_COUNT] = {
+    nullptr,            // the mesh's own materials
+    "Template/Blue",
+    "Template/Wall",
+};
+
+//-------------------------------------------------------------------------------------
+CreatureLayer::CreatureLayer(SceneManager *sceneMgr, Real spacing)
+    : m_sceneMgr(sceneMgr),
+      m_spacing(spacing),
+      m_size(0),
+      m_hasView(false),
+      m_viewRange(0)
+{
+    std::fill(m_templates, m_templates + KIND_COUNT, nullptr);
+    std::fill(m_scale, m_scale + KIND_COUNT, Real(1));
+    std::fill(m_offset, m_offset + KIND_COUNT, Vector3::ZERO);
+}
+
+CreatureLayer::~CreatureLayer()
+{
+    for (auto &it : m_batches) {
+        m_sceneMgr->destroyStaticGeometry(it.second.geometry);
+    }
+    for (Entity *e : m_templates) {
+        if (e) {
+            m_sceneMgr->destroyEntity(e);
+        }
+    }
+}
+
+// Loads each kind's mesh once and sizes it to fill one cell
+void CreatureLayer::createTemplates()
+{
+    for (int k = 0; k < KIND_COUNT; k++) {
+        m_templates[k] = CREATURE_MESHES[k] ? m_sceneMgr->createEntity(CREATURE_MESHES[k])
+                                            : m_sceneMgr->createEntity(SceneManager::PT_CUBE);
+        if (CREATURE_MATERIALS[k]) {
+            m_templates[k]->setMaterialName(CREATURE_MATERIALS[k]);
+        }
+
+        Vector3 bounds = m_templates[k]->getBoundingBox().getSize();
+        Real dim = std::max({bounds.x, bounds.y, bounds.z});
+        m_scale[k] = m_spacing / dim;
+        m_offset[k] = bounds * m_scale[k] * 0.5f;
+    }
+}
+
+// Whether the chunk holding batch is in view
+bool CreatureLayer::inView(const GridCell &batch) const
+{
+    const int shift = CHUNK_SHIFT - BATCH_SHIFT;
+    return !m_hasView || (std::abs((batch.x >> shift) - m_viewCentre.x) <= m_viewRange &&
+                          std::abs((batch.z >> shift) - m_viewCentre.z) <= m_viewRange);
+}
+
+void CreatureLayer::markDirty(Batch &batch)
+{
+    if (!batch.dirty) {
+        batch.dirty = true;
+        m_dirty.push_back(batch.coord);
+    }
+}
+
+void CreatureLayer::add(const GridCell &cell, Kind kind)
+{
+    if (!m_templates[0]) {
+        createTemplates();
+    }
+
+    const GridCell c(cell.x >> BATCH_SHIFT, cell.y >> BATCH_SHIFT, cell.z >> BATCH_SHIFT);
+    auto inserted = m_batches.insert(std::make_pair(packCell(c.x, c.y, c.z), Batch()));
+    Batch &batch = inserted.first->second;
+    if (inserted.second) {
+        String name = "creatures" + StringConverter::toString(c.x)
+                + "," + StringConverter::toString(c.y)
+                + "," + StringConverter::toString(c.z);
+        batch.coord = c;
+        batch.geometry = m_sceneMgr->createStaticGeometry(name);
+        // one region per batch, so whole batches are culled at once
+        const Real size = BATCH_CELLS * m_spacing;
+        batch.geometry->setRegionDimensions(Vector3(size, size, size));
+        batch.geometry->setOrigin(Vector3(c.x * size, c.y * size, c.z * size));
+        batch.dirty = false;
+        batch.built = false;
+    }
+
+    batch.cells[kind].push_back(packLocal(cell, BATCH_SHIFT));
+    m_size++;
+    if (inView(c)) {
+        markDirty(batch);
+    }
+}
+
+bool CreatureLayer::remove(const GridCell &cell, Kind kind)
+{
+    const GridCell c(cell.x >> BATCH_SHIFT, cell.y >> BATCH_SHIFT, cell.z >> BATCH_SHIFT);
+    auto it = m_batches.find(packCell(c.x, c.y, c.z));
+    if (it == m_batches.end()) {
+        return false;
+    }
+
+    Batch &batch = it->second;
+    std::vector<LocalCell> &cells = batch.cells[kind];
+    auto found = std::find(cells.begin(), cells.end(), packLocal(cell, BATCH_SHIFT));
+    if (found == cells.end()) {
+        return false;
+    }
+    *found = cells.back();
+    cells.pop_back();
+    m_size--;
+    if (inView(c)) {
+        markDirty(batch);
+    }
+    return true;
+}
+
+void CreatureLayer::clear()
+{
+    for (auto &it : m_batches) {
+        m_sceneMgr->destroyStaticGeometry(it.second.geometry);
+    }
+    m_batches.clear();
+    m_dirty.clear();
+    m_size = 0;
+}
+
+void CreatureLayer::setView(const GridCell &centre, int range)
+{
+    m_hasView = true;
+    m_viewCentre = centre;
+    m_viewRange = range;
+
+    for (auto &it : m_batches) {
+        Batch &batch = it.second;
+        if (inView(batch.coord)) {
+            if (!batch.built) {
+                markDirty(batch);
+            }
+        } else if (batch.built) {
+            batch.geometry->reset();
+            batch.built = false;
+        }
+    }
+}
+
+void CreatureLayer::update()
+{
+    for (const GridCell &c : m_dirty) {
+        Batch &batch = m_batches[packCell(c.x, c.y, c.z)];
+        batch.dirty = false;
+        // the view may have moved on since the batch was marked
+        if (inView(c)) {
+            rebuild(batch);
+        }
+    }
+    m_dirty.clear();
+}
+
+// StaticGeometry can't be added to once built, so the batch is baked again
+// from its creature list
+void CreatureLayer::rebuild(Batch &batch)
+{
+    StaticGeometry *geometry = batch.geometry;
+    geometry->reset();
+
+    const GridCell corner(batch.coord.x * BATCH_CELLS, batch.coord.y * BATCH_CELLS, batch.coord.z * BATCH_CELLS);
+    for (int k = 0; k < KIND_COUNT; k++) {
+        const Vector3 scale(m_scale[k], m_scale[k], m_scale[k]);
+        for (LocalCell l : batch.cells[k]) {
+            const GridCell cell = unpackLocal(l, corner);
+            Vector3 p(cell.x * m_spacing, cell.y * m_spacing, cell.z * m_spacing);
+            geometry->addEntity(m_templates[k], p + m_offset[k], Quaternion::IDENTITY, scale);
+        }
+    }
+
+    geometry->build();
+    batch.built = true;
+}
@@ -0,0 +1,101 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    CreatureLayer.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __CreatureLayer_h_
+#define __CreatureLayer_h_
+
+#include "GridMath.h"
+
+#include <OgreSceneManager.h>
+#include <OgreStaticGeometry.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Draws every creature and wall on the board, from one shared mesh per
+// kind. They are baked into a StaticGeometry per batch of BATCH_CELLS
+// cells a side, eight to a chunk, so the draw calls grow with the number
+// of batches in view, not with the number of creatures. Placing or
+// removing one only marks its batch, which is rebuilt by the next
+// update(); that bakes at most a batch's worth of creatures, not a whole
+// chunk's. Batches out of view keep their creature lists but drop their
+// geometry.
+class CreatureLayer
+{
+public:
+    enum Kind {
+        Troll = 0,
+        Ally,
+        Wall,
+        KIND_COUNT
+    };
+
+    CreatureLayer(Ogre::SceneManager *sceneMgr, Ogre::Real spacing);
+    ~CreatureLayer();
+
+    // The layer owns its scene objects
+    CreatureLayer(const CreatureLayer &) = delete;
+    CreatureLayer &operator=(const CreatureLayer &) = delete;
+
+    // Places a creature filling cell. Its mesh must already be loadable,
+    // i.e. the General resources are ready.
+    void add(const GridCell &cell, Kind kind);
+    // Removes one creature of kind from cell, returning false if there is
+    // none
+    bool remove(const GridCell &cell, Kind kind);
+
+    // Removes every creature
+    void clear();
+
+    // Only chunks no more than range chunks from centre along x and z are
+    // drawn. Until this is called, every chunk is.
+    void setView(const GridCell &centre, int range);
+
+    // Rebuilds the batches changed or brought into view since the last call
+    void update();
+
+    std::size_t size() const { return m_size; }
+
+private:
+    static const int BATCH_SHIFT = CHUNK_SHIFT - 1;
+    static const int BATCH_CELLS = 1 << BATCH_SHIFT;
+
+    struct Batch
+    {
+        // in batch units
+        GridCell coord;
+        Ogre::StaticGeometry *geometry;
+        // the creatures of each kind, as cells within the batch
+        std::vector<LocalCell> cells[KIND_COUNT];
+        bool dirty;
+        bool built;
+    };
+
+    void createTemplates();
+    bool inView(const GridCell &batch) const;
+    void markDirty(Batch &batch);
+    void rebuild(Batch &batch);
+
+    Ogre::SceneManager *m_sceneMgr;
+    Ogre::Real m_spacing;
+    std::size_t m_size;
+
+    // One entity per kind, never attached, that batches copy geometry from
+    Ogre::Entity *m_templates[KIND_COUNT];
+    // Mesh scale and the offset from the cell corner to the mesh origin,
+    // worked out once per kind from the mesh bounds
+    Ogre::Real m_scale[KIND_COUNT];
+    Ogre::Vector3 m_offset[KIND_COUNT];
+
+    std::unordered_map<std::uint64_t, Batch> m_batches;
+    std::vector<GridCell> m_dirty;
+
+    bool m_hasView;
+    GridCell m_viewCentre;
+    int m_viewRange;
+};
+
+#endif // #ifndef __CreatureLayer_h_
@@ -0,0 +1,177 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    EncounterFile.cpp
+-----------------------------------------------------------------------------
+*/
+#include "EncounterFile.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The arrays are used straight from the mapping
+static_assert(sizeof(GridCell) == 3 * sizeof(std::int32_t), "GridCell must be three packed int32s");
+static_assert(sizeof(CreatureType) == 1, "CreatureType must be one byte");
+static_assert(sizeof(EncounterHeader) % alignof(GridCell) == 0, "cells must be aligned");
+
+//-------------------------------------------------------------------------------------
+EncounterFile::EncounterFile()
+    : m_data(nullptr),
+      m_length(0),
+      m_count(0),
+      m_cells(nullptr),
+      m_types(nullptr)
+{
+}
+
+EncounterFile::~EncounterFile()
+{
+    close();
+}
+
+bool EncounterFile::fail(const std::string &path, const std::string &what)
+{
+    close();
+    m_error = path + ": " + what;
+    return false;
+}
+
+bool EncounterFile::open(const std::string &path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return fail(path, "can't be opened");
+    }
+    LARGE_INTEGER length;
+    GetFileSizeEx(file, &length);
+    m_length = std::size_t(length.QuadPart);
+    if (m_length) {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            m_data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+    if (m_length && !m_data) {
+        return fail(path, "can't be mapped");
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return fail(path, std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int e = errno;
+        ::close(fd);
+        return fail(path, std::strerror(e));
+    }
+    m_length = std::size_t(st.st_size);
+    if (m_length) {
+        void *data = mmap(nullptr, m_length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            int e = errno;
+            ::close(fd);
+            return fail(path, std::strerror(e));
+        }
+        m_data = data;
+        // the whole file is about to be read front to back
+        madvise(m_data, m_length, MADV_WILLNEED);
+    }
+    ::close(fd);
+#endif
+
+    if (m_length < sizeof(EncounterHeader)) {
+        return fail(path, "is not an encounter");
+    }
+    const EncounterHeader *header = static_cast<const EncounterHeader *>(m_data);
+    if (header->magic != EncounterHeader::MAGIC) {
+        return fail(path, "is not an encounter, or was written on another byte order");
+    }
+    if (header->version != EncounterHeader::VERSION) {
+        return fail(path, "is encounter version " + std::to_string(header->version)
+                    + ", expected " + std::to_string(EncounterHeader::VERSION));
+    }
+    if (m_length != sizeof(EncounterHeader) + std::size_t(header->count) * (sizeof(GridCell) + 1)) {
+        return fail(path, "is truncated");
+    }
+
+    const GridCell *cells = reinterpret_cast<const GridCell *>(header + 1);
+    for (std::size_t i = 0; i < header->count; i++) {
+        if (!cellInRange(cells[i])) {
+            return fail(path, "has creature " + std::to_string(i) + " off the board");
+        }
+    }
+
+    m_count = header->count;
+    m_cells = cells;
+    m_types = reinterpret_cast<const CreatureType *>(m_cells + m_count);
+    m_error.clear();
+    return true;
+}
+
+void EncounterFile::close()
+{
+    if (m_data) {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+#else
+        munmap(m_data, m_length);
+#endif
+    }
+    m_data = nullptr;
+    m_length = 0;
+    m_count = 0;
+    m_cells = nullptr;
+    m_types = nullptr;
+}
+
+//-------------------------------------------------------------------------------------
+bool saveEncounter(const std::string &path,
+                   const std::vector<GridCell> &cells,
+                   const std::vector<CreatureType> &types,
+                   std::string &error)
+{
+    if (cells.size() != types.size() || cells.size() > 0xffffffffu) {
+        error = path + ": bad creature list";
+        return false;
+    }
+
+    FILE *out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    EncounterHeader header;
+    header.magic = EncounterHeader::MAGIC;
+    header.version = EncounterHeader::VERSION;
+    header.count = std::uint32_t(cells.size());
+    header.reserved = 0;
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1;
+    if (!cells.empty()) {
+        ok = ok && std::fwrite(cells.data(), sizeof(GridCell), cells.size(), out) == cells.size();
+        ok = ok && std::fwrite(types.data(), 1, types.size(), out) == types.size();
+    }
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok) {
+        error = path + ": write failed";
+    }
+    return ok;
+}
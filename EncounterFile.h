@@ -0,0 +1,81 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    EncounterFile.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __EncounterFile_h_
+#define __EncounterFile_h_
+
+#include "GridMath.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What a creature on the board is
+enum CreatureType : std::uint8_t {
+    TrollCreature = 0,
+    AllyCreature = 1
+};
+
+// The on-disk encounter format, in the byte order of the machine that
+// wrote it:
+//
+//     EncounterHeader
+//     GridCell        cells[count]     three int32 each
+//     CreatureType    types[count]     one byte each
+//
+// Nothing needs parsing, so a mapped file is used in place.
+struct EncounterHeader
+{
+    static const std::uint32_t MAGIC = 0x434e4545; // "EENC" read as little endian
+    static const std::uint32_t VERSION = 1;
+
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t count;
+    std::uint32_t reserved;
+};
+
+// An encounter file mapped read-only into memory. The arrays stay valid
+// until the file is closed or another is opened.
+class EncounterFile
+{
+public:
+    EncounterFile();
+    ~EncounterFile();
+
+    EncounterFile(const EncounterFile &) = delete;
+    EncounterFile &operator=(const EncounterFile &) = delete;
+
+    // Maps the file at path, returning false with error() set if it can't
+    // be read, isn't an encounter of this version or has a creature
+    // outside cellInRange()
+    bool open(const std::string &path);
+    void close();
+
+    std::size_t size() const { return m_count; }
+    const GridCell *cells() const { return m_cells; }
+    const CreatureType *types() const { return m_types; }
+
+    const std::string &error() const { return m_error; }
+
+private:
+    bool fail(const std::string &path, const std::string &what);
+
+    void *m_data;
+    std::size_t m_length;
+    std::size_t m_count;
+    const GridCell *m_cells;
+    const CreatureType *m_types;
+    std::string m_error;
+};
+
+// Writes an encounter of cells.size() creatures, returning false with a
+// message in error on failure
+bool saveEncounter(const std::string &path,
+                   const std::vector<GridCell> &cells,
+                   const std::vector<CreatureType> &types,
+                   std::string &error);
+
+#endif // #ifndef __EncounterFile_h_
@@ -0,0 +1,96 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    FloorGrid.cpp
+-----------------------------------------------------------------------------
+*/
+#include "FloorGrid.h"
+
+#include <OgreEntity.h>
+#include <OgreManualObject.h>
+#include <OgreMeshManager.h>
+#include <OgreResourceGroupManager.h>
+
+using namespace Ogre;
+
+static const char *const GRID_MESH = "gridChunk";
+
+//-------------------------------------------------------------------------------------
+FloorGrid::FloorGrid(SceneManager *sceneMgr, Real spacing)
+    : m_sceneMgr(sceneMgr),
+      m_spacing(spacing)
+{
+    // The lines along the low x and z edges of every cell of one chunk.
+    // The chunks next to it draw the other edges.
+    const Real size = CHUNK_CELLS * m_spacing;
+    ManualObject *man = m_sceneMgr->createManualObject();
+    man->begin("BaseWhiteNoLighting", RenderOperation::OT_LINE_LIST);
+    for (int i = 0; i < CHUNK_CELLS; i++) {
+        man->position(i * m_spacing, 0, 0);
+        man->position(i * m_spacing, 0, size);
+
+        man->position(0, 0, i * m_spacing);
+        man->position(size, 0, i * m_spacing);
+    }
+    man->end();
+
+    // kept out of General, which may still be loading in the background
+    m_mesh = man->convertToMesh(GRID_MESH, ResourceGroupManager::INTERNAL_RESOURCE_GROUP_NAME);
+    m_sceneMgr->destroyManualObject(man);
+}
+
+FloorGrid::~FloorGrid()
+{
+    for (auto &it : m_shown) {
+        m_free.push_back(it.second);
+    }
+    for (SceneNode *node : m_free) {
+        MovableObject *grid = node->getAttachedObject(0);
+        node->detachAllObjects();
+        m_sceneMgr->destroyMovableObject(grid);
+        m_sceneMgr->destroySceneNode(node);
+    }
+    MeshManager::getSingleton().remove(m_mesh->getHandle());
+}
+
+std::uint64_t FloorGrid::key(int cx, int cz)
+{
+    return std::uint64_t(std::uint32_t(cx)) | std::uint64_t(std::uint32_t(cz)) << 32;
+}
+
+void FloorGrid::setView(const GridCell &centre, int range)
+{
+    SceneNode *root = m_sceneMgr->getRootSceneNode();
+
+    for (auto it = m_shown.begin(); it != m_shown.end();) {
+        const std::uint64_t k = it->first;
+        const int cx = int(std::uint32_t(k));
+        const int cz = int(std::uint32_t(k >> 32));
+        if (std::abs(cx - centre.x) > range || std::abs(cz - centre.z) > range) {
+            root->removeChild(it->second);
+            m_free.push_back(it->second);
+            it = m_shown.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    const Real size = CHUNK_CELLS * m_spacing;
+    for (int cz = centre.z - range; cz <= centre.z + range; cz++) {
+        for (int cx = centre.x - range; cx <= centre.x + range; cx++) {
+            SceneNode *&node = m_shown[key(cx, cz)];
+            if (node) {
+                continue;
+            }
+
+            if (m_free.empty()) {
+                node = m_sceneMgr->createSceneNode();
+                node->attachObject(m_sceneMgr->createEntity(m_mesh));
+            } else {
+                node = m_free.back();
+                m_free.pop_back();
+            }
+            root->addChild(node);
+            node->setPosition(cx * size, 0, cz * size);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    FloorGrid.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __FloorGrid_h_
+#define __FloorGrid_h_
+
+#include "GridMath.h"
+
+#include <OgreMesh.h>
+#include <OgreSceneManager.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// The grid lines on the floor, drawn one chunk at a time around a moving
+// centre, so the board has no edge. Every chunk shares one line mesh;
+// chunks that go out of range are kept in a pool and moved to where they
+// are next needed.
+class FloorGrid
+{
+public:
+    FloorGrid(Ogre::SceneManager *sceneMgr, Ogre::Real spacing);
+    ~FloorGrid();
+
+    FloorGrid(const FloorGrid &) = delete;
+    FloorGrid &operator=(const FloorGrid &) = delete;
+
+    // Shows the chunks no more than range chunks from centre along x and
+    // z, on the y = 0 floor
+    void setView(const GridCell &centre, int range);
+
+    std::size_t chunkCount() const { return m_shown.size(); }
+
+private:
+    static std::uint64_t key(int cx, int cz);
+
+    Ogre::SceneManager *m_sceneMgr;
+    Ogre::Real m_spacing;
+    Ogre::MeshPtr m_mesh;
+
+    std::unordered_map<std::uint64_t, Ogre::SceneNode*> m_shown;
+    std::vector<Ogre::SceneNode*> m_free;
+};
+
+#endif // #ifndef __FloorGrid_h_
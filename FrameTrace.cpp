@@ -0,0 +1,72 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    FrameTrace.cpp
+-----------------------------------------------------------------------------
+*/
+#include "FrameTrace.h"
+
+#include <cstdio>
+
+// Small, stable thread ids for the trace viewer
+static unsigned currentThread()
+{
+    static std::atomic<unsigned> next(1);
+    static thread_local unsigned id = next++;
+    return id;
+}
+
+//-------------------------------------------------------------------------------------
+FrameTrace &FrameTrace::instance()
+{
+    static FrameTrace trace;
+    return trace;
+}
+
+FrameTrace::FrameTrace()
+    : m_enabled(false),
+      m_start(Clock::now())
+{
+}
+
+void FrameTrace::setEnabled(bool enabled)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (enabled && !m_enabled) {
+        m_events.clear();
+        m_start = Clock::now();
+    }
+    m_enabled = enabled;
+}
+
+void FrameTrace::record(const char *name, Clock::time_point begin, Clock::time_point end)
+{
+    if (!enabled()) {
+        return;
+    }
+
+    Event e = { name, begin, end, currentThread() };
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_events.size() < MAX_EVENTS) {
+        m_events.push_back(e);
+    }
+}
+
+bool FrameTrace::write(const std::string &path) const
+{
+    FILE *out = std::fopen(path.c_str(), "w");
+    if (!out) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (std::size_t i = 0; i < m_events.size(); i++) {
+        const Event &e = m_events[i];
+        double ts = std::chrono::duration<double, std::micro>(e.begin - m_start).count();
+        double dur = std::chrono::duration<double, std::micro>(e.end - e.begin).count();
+        std::fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                     i ? "," : "", e.name, ts, dur, e.thread);
+    }
+    std::fprintf(out, "\n]}\n");
+    return std::fclose(out) == 0;
+}
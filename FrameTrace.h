@@ -0,0 +1,80 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    FrameTrace.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __FrameTrace_h_
+#define __FrameTrace_h_
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Collects timed spans while enabled and writes them out in the Chrome
+// trace event format, which chrome://tracing and Perfetto both open.
+// While disabled, recording a span costs a single flag test.
+class FrameTrace
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Spans kept per recording, after which new ones are dropped
+    static const std::size_t MAX_EVENTS = 1 << 20;
+
+    static FrameTrace &instance();
+
+    bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    // Enabling starts a fresh recording
+    void setEnabled(bool enabled);
+
+    // Records a span. name must outlive the recording, e.g. a literal.
+    void record(const char *name, Clock::time_point begin, Clock::time_point end);
+
+    // Writes the current recording as JSON, returning false on failure
+    bool write(const std::string &path) const;
+
+private:
+    FrameTrace();
+
+    struct Event {
+        const char *name;
+        Clock::time_point begin;
+        Clock::time_point end;
+        unsigned thread;
+    };
+
+    std::atomic<bool> m_enabled;
+    Clock::time_point m_start;
+    mutable std::mutex m_lock;
+    std::vector<Event> m_events;
+};
+
+// Records the span of its own lifetime, if tracing is enabled when it is
+// created
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : m_name(FrameTrace::instance().enabled() ? name : nullptr) {
+        if (m_name) {
+            m_begin = FrameTrace::Clock::now();
+        }
+    }
+
+    ~TraceScope() {
+        if (m_name) {
+            FrameTrace::instance().record(m_name, m_begin, FrameTrace::Clock::now());
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *m_name;
+    FrameTrace::Clock::time_point m_begin;
+};
+
+#endif // #ifndef __FrameTrace_h_
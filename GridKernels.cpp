@@ -0,0 +1,320 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    GridKernels.cpp
+-----------------------------------------------------------------------------
+*/
+#include "GridKernels.h"
+#include "AreaShapes.h"
+
+#include <atomic>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define GRID_KERNELS_X86
+// the vector kernels are built for their own instruction set, whatever
+// the rest of the program is built for
+#define TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define GRID_KERNELS_X86
+#define TARGET(isa)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+typedef void (*Distance3Kernel)(const int *, const int *, const int *, std::size_t,
+                                const GridCell &, int *);
+typedef void (*Within45Kernel)(const int *, const int *, const int *, std::size_t,
+                               const GridCell &, const GridCell &, std::uint8_t *);
+
+//-------------------------------------------------------------------------------------
+// The reference: the scalar functions themselves, and the tail of every
+// vector kernel
+static void distance3Scalar(const int *x, const int *y, const int *z, std::size_t n,
+                            const GridCell &origin, int *out)
+{
+    for (std::size_t i = 0; i < n; i++) {
+        out[i] = distance3(x[i] - origin.x, y[i] - origin.y, z[i] - origin.z);
+    }
+}
+
+static void within45Scalar(const int *x, const int *y, const int *z, std::size_t n,
+                           const GridCell &origin, const GridCell &dir, std::uint8_t *out)
+{
+    for (std::size_t i = 0; i < n; i++) {
+        out[i] = within45(GridCell(x[i] - origin.x, y[i] - origin.y, z[i] - origin.z), dir);
+    }
+}
+
+#ifdef GRID_KERNELS_X86
+// distance3 without branches. With the absolute coordinates sorted as
+// lo <= mid <= hi, the axis with the smallest is the one dropped, so
+//
+//     distance3 = (hi - mid) + 3 (mid - lo) / 2 + 7 lo / 4
+//
+// where every term is non-negative, so the divisions are shifts.
+TARGET("avx2")
+static void distance3Avx2(const int *x, const int *y, const int *z, std::size_t n,
+                          const GridCell &origin, int *out)
+{
+    const __m256i ox = _mm256_set1_epi32(origin.x);
+    const __m256i oy = _mm256_set1_epi32(origin.y);
+    const __m256i oz = _mm256_set1_epi32(origin.z);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i a = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(x + i)), ox));
+        const __m256i b = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(y + i)), oy));
+        const __m256i c = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(z + i)), oz));
+
+        const __m256i lo = _mm256_min_epi32(a, _mm256_min_epi32(b, c));
+        const __m256i hi = _mm256_max_epi32(a, _mm256_max_epi32(b, c));
+        const __m256i mid = _mm256_max_epi32(_mm256_min_epi32(a, b),
+                                             _mm256_min_epi32(_mm256_max_epi32(a, b), c));
+
+        const __m256i low = _mm256_sub_epi32(mid, lo);
+        __m256i d = _mm256_sub_epi32(hi, mid);
+        d = _mm256_add_epi32(d, _mm256_srai_epi32(_mm256_add_epi32(low, _mm256_slli_epi32(low, 1)), 1));
+        d = _mm256_add_epi32(d, _mm256_srai_epi32(_mm256_sub_epi32(_mm256_slli_epi32(lo, 3), lo), 2));
+        _mm256_storeu_si256((__m256i *)(out + i), d);
+    }
+    distance3Scalar(x + i, y + i, z + i, n - i, origin, out + i);
+}
+
+TARGET("sse4.1")
+static void distance3Sse41(const int *x, const int *y, const int *z, std::size_t n,
+                           const GridCell &origin, int *out)
+{
+    const __m128i ox = _mm_set1_epi32(origin.x);
+    const __m128i oy = _mm_set1_epi32(origin.y);
+    const __m128i oz = _mm_set1_epi32(origin.z);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128i a = _mm_abs_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i *)(x + i)), ox));
+        const __m128i b = _mm_abs_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i *)(y + i)), oy));
+        const __m128i c = _mm_abs_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i *)(z + i)), oz));
+
+        const __m128i lo = _mm_min_epi32(a, _mm_min_epi32(b, c));
+        const __m128i hi = _mm_max_epi32(a, _mm_max_epi32(b, c));
+        const __m128i mid = _mm_max_epi32(_mm_min_epi32(a, b),
+                                          _mm_min_epi32(_mm_max_epi32(a, b), c));
+
+        const __m128i low = _mm_sub_epi32(mid, lo);
+        __m128i d = _mm_sub_epi32(hi, mid);
+        d = _mm_add_epi32(d, _mm_srai_epi32(_mm_add_epi32(low, _mm_slli_epi32(low, 1)), 1));
+        d = _mm_add_epi32(d, _mm_srai_epi32(_mm_sub_epi32(_mm_slli_epi32(lo, 3), lo), 2));
+        _mm_storeu_si128((__m128i *)(out + i), d);
+    }
+    distance3Scalar(x + i, y + i, z + i, n - i, origin, out + i);
+}
+
+// For each 8 bit mask, its bits one to a byte, lowest first
+struct MaskBytes
+{
+    std::uint8_t bytes[256][8];
+
+    MaskBytes() {
+        for (int m = 0; m < 256; m++) {
+            for (int k = 0; k < 8; k++) {
+                bytes[m][k] = (m >> k) & 1;
+            }
+        }
+    }
+
+    const std::uint8_t *operator[](int m) const { return bytes[m]; }
+};
+static const MaskBytes MASK_BYTES;
+
+// within45 in doubles, which hold the products exactly: below 2^24 per
+// axis, 2 dot^2 and |a|^2 |dir|^2 stay under 2^53. dir is a grid
+// direction, so the dot product is a sum of coordinates and stays an int.
+TARGET("avx2")
+static inline int within45Avx2Half(__m128i a, __m128i b, __m128i c, __m128i dot, __m256d lb)
+{
+    const __m256d da = _mm256_cvtepi32_pd(a);
+    const __m256d db = _mm256_cvtepi32_pd(b);
+    const __m256d dc = _mm256_cvtepi32_pd(c);
+    const __m256d dd = _mm256_cvtepi32_pd(dot);
+    const __m256d la = _mm256_add_pd(_mm256_mul_pd(da, da),
+                                     _mm256_add_pd(_mm256_mul_pd(db, db), _mm256_mul_pd(dc, dc)));
+    const __m256d dot2 = _mm256_mul_pd(_mm256_add_pd(dd, dd), dd);
+    const __m256d in = _mm256_and_pd(_mm256_cmp_pd(dd, _mm256_setzero_pd(), _CMP_GT_OQ),
+                                     _mm256_cmp_pd(dot2, _mm256_mul_pd(la, lb), _CMP_GE_OQ));
+    return _mm256_movemask_pd(in);
+}
+
+TARGET("avx2")
+static void within45Avx2(const int *x, const int *y, const int *z, std::size_t n,
+                         const GridCell &origin, const GridCell &dir, std::uint8_t *out)
+{
+    const __m256i ox = _mm256_set1_epi32(origin.x);
+    const __m256i oy = _mm256_set1_epi32(origin.y);
+    const __m256i oz = _mm256_set1_epi32(origin.z);
+    const __m256i sx = _mm256_set1_epi32(dir.x);
+    const __m256i sy = _mm256_set1_epi32(dir.y);
+    const __m256i sz = _mm256_set1_epi32(dir.z);
+    const __m256d lb = _mm256_set1_pd(double(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i a = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(x + i)), ox);
+        const __m256i b = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(y + i)), oy);
+        const __m256i c = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(z + i)), oz);
+        // sign_epi32 multiplies by -1, 0 or 1
+        const __m256i dot = _mm256_add_epi32(_mm256_sign_epi32(a, sx),
+                                             _mm256_add_epi32(_mm256_sign_epi32(b, sy),
+                                                              _mm256_sign_epi32(c, sz)));
+
+        const int bits = within45Avx2Half(_mm256_castsi256_si128(a), _mm256_castsi256_si128(b),
+                                          _mm256_castsi256_si128(c), _mm256_castsi256_si128(dot), lb)
+                       | within45Avx2Half(_mm256_extracti128_si256(a, 1), _mm256_extracti128_si256(b, 1),
+                                          _mm256_extracti128_si256(c, 1), _mm256_extracti128_si256(dot, 1), lb) << 4;
+        std::memcpy(out + i, MASK_BYTES[bits], 8);
+    }
+    within45Scalar(x + i, y + i, z + i, n - i, origin, dir, out + i);
+}
+
+// The lower two lanes only
+TARGET("sse4.1")
+static inline int within45Sse41Half(__m128i a, __m128i b, __m128i c, __m128i dot, __m128d lb)
+{
+    const __m128d da = _mm_cvtepi32_pd(a);
+    const __m128d db = _mm_cvtepi32_pd(b);
+    const __m128d dc = _mm_cvtepi32_pd(c);
+    const __m128d dd = _mm_cvtepi32_pd(dot);
+    const __m128d la = _mm_add_pd(_mm_mul_pd(da, da),
+                                  _mm_add_pd(_mm_mul_pd(db, db), _mm_mul_pd(dc, dc)));
+    const __m128d dot2 = _mm_mul_pd(_mm_add_pd(dd, dd), dd);
+    const __m128d in = _mm_and_pd(_mm_cmpgt_pd(dd, _mm_setzero_pd()),
+                                  _mm_cmpge_pd(dot2, _mm_mul_pd(la, lb)));
+    return _mm_movemask_pd(in);
+}
+
+TARGET("sse4.1")
+static void within45Sse41(const int *x, const int *y, const int *z, std::size_t n,
+                          const GridCell &origin, const GridCell &dir, std::uint8_t *out)
+{
+    const __m128i ox = _mm_set1_epi32(origin.x);
+    const __m128i oy = _mm_set1_epi32(origin.y);
+    const __m128i oz = _mm_set1_epi32(origin.z);
+    const __m128i sx = _mm_set1_epi32(dir.x);
+    const __m128i sy = _mm_set1_epi32(dir.y);
+    const __m128i sz = _mm_set1_epi32(dir.z);
+    const __m128d lb = _mm_set1_pd(double(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z));
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128i a = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(x + i)), ox);
+        const __m128i b = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(y + i)), oy);
+        const __m128i c = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(z + i)), oz);
+        const __m128i dot = _mm_add_epi32(_mm_sign_epi32(a, sx),
+                                          _mm_add_epi32(_mm_sign_epi32(b, sy), _mm_sign_epi32(c, sz)));
+
+        // the second call gets the upper two lanes moved down
+        const int bits = within45Sse41Half(a, b, c, dot, lb)
+                       | within45Sse41Half(_mm_srli_si128(a, 8), _mm_srli_si128(b, 8),
+                                           _mm_srli_si128(c, 8), _mm_srli_si128(dot, 8), lb) << 2;
+        std::memcpy(out + i, MASK_BYTES[bits], 4);
+    }
+    within45Scalar(x + i, y + i, z + i, n - i, origin, dir, out + i);
+}
+#endif // GRID_KERNELS_X86
+
+//-------------------------------------------------------------------------------------
+struct KernelSet
+{
+    const char *name;
+    Distance3Kernel distance3;
+    Within45Kernel within45;
+};
+
+static const KernelSet KERNELS[] = {
+#ifdef GRID_KERNELS_X86
+    { "avx2", distance3Avx2, within45Avx2 },
+    { "sse4.1", distance3Sse41, within45Sse41 },
+#endif
+    { "scalar", distance3Scalar, within45Scalar },
+};
+
+static bool supported(const KernelSet &k)
+{
+#if defined(GRID_KERNELS_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    const bool sse41 = (info[2] >> 19) & 1;
+    // AVX needs the OS to save the ymm registers too
+    const bool avx = ((info[2] >> 27) & 1) && ((info[2] >> 28) & 1) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    const bool avx2 = avx && ((info[1] >> 5) & 1);
+#elif defined(GRID_KERNELS_X86)
+    __builtin_cpu_init();
+    const bool sse41 = __builtin_cpu_supports("sse4.1");
+    const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+#ifdef GRID_KERNELS_X86
+    if (std::strcmp(k.name, "avx2") == 0) return avx2;
+    if (std::strcmp(k.name, "sse4.1") == 0) return sse41;
+#endif
+    return std::strcmp(k.name, "scalar") == 0;
+}
+
+// The best the CPU can run
+static const KernelSet *selectKernels()
+{
+    for (const KernelSet &k : KERNELS) {
+        if (supported(k)) {
+            return &k;
+        }
+    }
+    return &KERNELS[sizeof(KERNELS) / sizeof(KERNELS[0]) - 1];
+}
+
+// The kernels in use, picked the first time they are asked for. The static
+// is initialised once even if several threads get here first, and is
+// atomic so useGridKernels() can switch it under running batches.
+static std::atomic<const KernelSet *> &current()
+{
+    static std::atomic<const KernelSet *> kernels(selectKernels());
+    return kernels;
+}
+
+static const KernelSet &kernels()
+{
+    return *current().load(std::memory_order_relaxed);
+}
+
+void distance3Batch(const CellArrays &cells, const GridCell &origin, int *out)
+{
+    if (cells.size()) {
+        kernels().distance3(&cells.x[0], &cells.y[0], &cells.z[0], cells.size(), origin, out);
+    }
+}
+
+void distance3Batch(const int *x, const int *y, const int *z, std::size_t n,
+                    const GridCell &origin, int *out)
+{
+    if (n) {
+        kernels().distance3(x, y, z, n, origin, out);
+    }
+}
+
+void within45Batch(const CellArrays &cells, const GridCell &origin, const GridCell &dir,
+                   std::uint8_t *out)
+{
+    if (cells.size()) {
+        kernels().within45(&cells.x[0], &cells.y[0], &cells.z[0], cells.size(), origin, dir, out);
+    }
+}
+
+const char *gridKernelName()
+{
+    return kernels().name;
+}
+
+bool useGridKernels(const char *name)
+{
+    for (const KernelSet &k : KERNELS) {
+        if (std::strcmp(k.name, name) == 0 && supported(k)) {
+            current().store(&k, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
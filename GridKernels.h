@@ -0,0 +1,52 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    GridKernels.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __GridKernels_h_
+#define __GridKernels_h_
+
+#include "GridMath.h"
+
+#include <cstdint>
+#include <vector>
+
+// Cells in structure-of-arrays layout, so a batch kernel loads 8 of one
+// coordinate at once
+struct CellArrays
+{
+    std::vector<int> x, y, z;
+
+    std::size_t size() const { return x.size(); }
+    void clear() { x.clear(); y.clear(); z.clear(); }
+    void reserve(std::size_t n) { x.reserve(n); y.reserve(n); z.reserve(n); }
+    void push_back(const GridCell &c) { x.push_back(c.x); y.push_back(c.y); z.push_back(c.z); }
+    GridCell operator[](std::size_t i) const { return GridCell(x[i], y[i], z[i]); }
+};
+
+// Batch versions of distance3() and within45() over the offsets of many
+// cells from one origin. They use AVX2 or SSE4.1 when the CPU has them,
+// picked on first use, and give exactly what the scalar functions do for
+// offsets below 2^24 cells along each axis.
+
+// out[i] = distance3(cells[i] - origin)
+void distance3Batch(const CellArrays &cells, const GridCell &origin, int *out);
+// The same over the n cells {x[i], y[i], z[i]}, for callers filling
+// arrays of their own
+void distance3Batch(const int *x, const int *y, const int *z, std::size_t n,
+                    const GridCell &origin, int *out);
+
+// out[i] = within45(cells[i] - origin, dir). dir must be a grid
+// direction, every coordinate -1, 0 or 1.
+void within45Batch(const CellArrays &cells, const GridCell &origin, const GridCell &dir,
+                   std::uint8_t *out);
+
+// The kernels in use: "avx2", "sse4.1" or "scalar"
+const char *gridKernelName();
+
+// Switches to the kernels called name, returning false if there are none
+// by that name or the CPU can't run them. Batches already running on other
+// threads finish with the kernels they started with.
+bool useGridKernels(const char *name);
+
+#endif // #ifndef __GridKernels_h_
@@ -0,0 +1,150 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    GridMath.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __GridMath_h_
+#define __GridMath_h_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+// A cell on the integer grid. One unit is one grid square, i.e.
+// TutorialApplication::GRID_SPACING in world space.
+struct GridCell
+{
+    int x, y, z;
+
+    GridCell() : x(0), y(0), z(0) {}
+    GridCell(int _x, int _y, int _z) : x(_x), y(_y), z(_z) {}
+
+    bool operator==(const GridCell &o) const { return x == o.x && y == o.y && z == o.z; }
+    bool operator!=(const GridCell &o) const { return !(*this == o); }
+    GridCell operator+(const GridCell &o) const { return GridCell(x + o.x, y + o.y, z + o.z); }
+    GridCell operator-(const GridCell &o) const { return GridCell(x - o.x, y - o.y, z - o.z); }
+};
+
+// The board is stored and drawn in cubic chunks of CHUNK_CELLS cells along
+// each axis, so only the chunks near the camera need to be in the scene
+static const int CHUNK_SHIFT = 4;
+static const int CHUNK_CELLS = 1 << CHUNK_SHIFT;
+
+// The chunk holding cell, in chunk units
+inline GridCell chunkOf(const GridCell &c) {
+    return GridCell(c.x >> CHUNK_SHIFT, c.y >> CHUNK_SHIFT, c.z >> CHUNK_SHIFT);
+}
+
+// Packs a cell, or a bucket or chunk coordinate, into a hash key. 21 bits
+// per axis is far more than any board will need.
+inline std::uint64_t packCell(int x, int y, int z) {
+    const std::uint64_t mask = (std::uint64_t(1) << 21) - 1;
+    return (std::uint64_t(x) & mask)
+            | (std::uint64_t(y) & mask) << 21
+            | (std::uint64_t(z) & mask) << 42;
+}
+
+// Cells on the board lie in [-CELL_LIMIT, CELL_LIMIT) along each axis,
+// which packCell() can pack without two of them sharing a key. That also
+// leaves the areas and bounding boxes around them far from overflowing.
+static const int CELL_LIMIT = 1 << 20;
+
+inline bool cellInRange(const GridCell &c) {
+    return c.x >= -CELL_LIMIT && c.x < CELL_LIMIT
+            && c.y >= -CELL_LIMIT && c.y < CELL_LIMIT
+            && c.z >= -CELL_LIMIT && c.z < CELL_LIMIT;
+}
+
+// The offset from origin to cell, if cell is no more than radius cells
+// from origin along any axis. It is worked out in 64 bits, so the two can
+// be any cells at all, not just ones on the board.
+inline bool offsetWithin(const GridCell &origin, const GridCell &cell, int radius, GridCell &offset) {
+    const long long x = static_cast<long long>(cell.x) - origin.x;
+    const long long y = static_cast<long long>(cell.y) - origin.y;
+    const long long z = static_cast<long long>(cell.z) - origin.z;
+    if (std::llabs(x) > radius || std::llabs(y) > radius || std::llabs(z) > radius) {
+        return false;
+    }
+    offset = GridCell(int(x), int(y), int(z));
+    return true;
+}
+
+// The x, y and z that packCell() packed into key. Shifting each field up
+// to the top bit and back down restores its sign.
+inline GridCell unpackCell(std::uint64_t key) {
+    return GridCell(int(std::int64_t(key << 43) >> 43),
+                    int(std::int64_t(key << 22) >> 43),
+                    int(std::int64_t(key << 1) >> 43));
+}
+
+// A cell inside an aligned block of at most 2^LOCAL_BITS cells a side,
+// such as a chunk or a hash bucket, packed into 32 bits as its offset
+// from the block's low corner. A third of the size of a GridCell, for the
+// long lists of cells kept per block.
+typedef std::uint32_t LocalCell;
+static const int LOCAL_BITS = 10;
+
+inline LocalCell packLocal(const GridCell &c, int blockShift) {
+    const int mask = (1 << blockShift) - 1;
+    return LocalCell(c.x & mask)
+            | LocalCell(c.y & mask) << LOCAL_BITS
+            | LocalCell(c.z & mask) << 2 * LOCAL_BITS;
+}
+
+// corner is the block's low corner, i.e. its coordinate << blockShift
+inline GridCell unpackLocal(LocalCell l, const GridCell &corner) {
+    const LocalCell mask = (1 << LOCAL_BITS) - 1;
+    return GridCell(corner.x + int(l & mask),
+                    corner.y + int(l >> LOCAL_BITS & mask),
+                    corner.z + int(l >> 2 * LOCAL_BITS & mask));
+}
+
+// One of the 48 symmetries of the grid cube: an axis permutation followed
+// by sign flips. Axis i of the result is axis axis[i] of the input,
+// multiplied by sign[i].
+struct GridSymmetry
+{
+    int axis[3];
+    int sign[3];
+
+    GridCell apply(const GridCell &c) const {
+        const int v[3] = { c.x, c.y, c.z };
+        return GridCell(sign[0] * v[axis[0]], sign[1] * v[axis[1]], sign[2] * v[axis[2]]);
+    }
+
+    GridCell invert(const GridCell &c) const {
+        int v[3];
+        v[axis[0]] = sign[0] * c.x;
+        v[axis[1]] = sign[1] * c.y;
+        v[axis[2]] = sign[2] * c.z;
+        return GridCell(v[0], v[1], v[2]);
+    }
+};
+
+// Grid distance in two dimensions, where every second diagonal step costs
+// double. Both arguments must be non-negative.
+inline int distance(int x, int y) {
+    return std::abs(x - y) + std::min(x, y) * 3 / 2;
+}
+
+// Grid distance in three dimensions, in cells
+inline int distance3(int _x, int _y, int _z) {
+    int x(std::abs(_x)), y(std::abs(_y)), z(std::abs(_z));
+    int c = std::min({x, y, z});
+    int d2;
+    if (x == c) {
+        d2 = distance(y - c, z - c);
+    } else if (y == c) {
+        d2 = distance(x - c, z - c);
+    } else {
+        d2 = distance(x - c, y - c);
+    }
+
+    return d2 + c * 7 / 4;
+}
+
+inline int distance3(const GridCell &c) {
+    return distance3(c.x, c.y, c.z);
+}
+
+#endif // #ifndef __GridMath_h_
@@ -0,0 +1,112 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    InputLog.cpp
+-----------------------------------------------------------------------------
+*/
+#include "InputLog.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+// Events are written and read as they are laid out in memory
+static_assert(sizeof(InputEvent) == 56, "InputEvent must have no padding");
+static_assert(sizeof(GridCell) == 3 * sizeof(std::int32_t), "GridCell must be three packed int32s");
+
+//-------------------------------------------------------------------------------------
+InputRecorder::InputRecorder()
+    : m_out(nullptr),
+      m_count(0),
+      m_failed(false)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+    std::string error;
+    stop(error);
+}
+
+bool InputRecorder::start(const std::string &path, std::string &error)
+{
+    stop(error);
+
+    m_out = std::fopen(path.c_str(), "wb");
+    if (!m_out) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    InputLogHeader header;
+    header.magic = InputLogHeader::MAGIC;
+    header.version = InputLogHeader::VERSION;
+    header.count = 0;
+    header.reserved = 0;
+    m_path = path;
+    m_count = 0;
+    m_failed = std::fwrite(&header, sizeof(header), 1, m_out) != 1;
+    m_start = Clock::now();
+    return true;
+}
+
+void InputRecorder::record(InputEvent event)
+{
+    if (!m_out || m_count == 0xffffffffu) {
+        return;
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_start);
+    event.time = std::uint64_t(elapsed.count());
+    event.reserved = 0;
+    m_failed = m_failed || std::fwrite(&event, sizeof(event), 1, m_out) != 1;
+    m_count++;
+}
+
+bool InputRecorder::stop(std::string &error)
+{
+    if (!m_out) {
+        return true;
+    }
+
+    bool ok = !m_failed;
+    if (ok) {
+        const std::uint32_t count = m_count;
+        ok = std::fseek(m_out, offsetof(InputLogHeader, count), SEEK_SET) == 0 &&
+             std::fwrite(&count, sizeof(count), 1, m_out) == 1;
+    }
+    ok = std::fclose(m_out) == 0 && ok;
+    m_out = nullptr;
+    if (!ok) {
+        error = m_path + ": write failed";
+    }
+    return ok;
+}
+
+//-------------------------------------------------------------------------------------
+bool loadInputLog(const std::string &path, std::vector<InputEvent> &events, std::string &error)
+{
+    std::FILE *in = std::fopen(path.c_str(), "rb");
+    if (!in) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    InputLogHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, in) == 1;
+    if (!ok || header.magic != InputLogHeader::MAGIC) {
+        error = path + ": is not an input log, or was written on another byte order";
+        ok = false;
+    } else if (header.version != InputLogHeader::VERSION) {
+        error = path + ": is input log version " + std::to_string(header.version)
+                + ", expected " + std::to_string(InputLogHeader::VERSION);
+        ok = false;
+    } else {
+        events.resize(header.count);
+        ok = header.count == 0 ||
+             std::fread(&events[0], sizeof(InputEvent), events.size(), in) == events.size();
+        if (!ok) {
+            error = path + ": is truncated";
+        }
+    }
+    std::fclose(in);
+    return ok;
+}
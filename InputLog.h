@@ -0,0 +1,112 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    InputLog.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __InputLog_h_
+#define __InputLog_h_
+
+#include "BoardSettings.h"
+#include "GridMath.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// What an input event was
+enum InputEventType : std::uint8_t {
+    // a key went down or up; code is the BoardCommand it ran, if any
+    KeyPressedEvent = 0,
+    KeyReleasedEvent = 1,
+    // the mouse was picked onto new cells, once a frame at most
+    PickedEvent = 2,
+    // a mouse button was released; code is the OIS button
+    ClickedEvent = 3,
+    // what was on the board when the recording started, one event per
+    // creature (code is its CreatureType) or wall, all at time 0
+    CreatureEvent = 4,
+    WallEvent = 5,
+    // the cones of the current size were built, so they can be evaluated
+    // and solved for; also at time 0 if they already were
+    ConesReadyEvent = 6
+};
+
+// One input event and the state it left the application in. The cells are
+// the ones picking resolved to, so a replay needs no camera or scene; for a
+// pick they are the cells it moved to.
+struct InputEvent
+{
+    // microseconds since the recording started
+    std::uint64_t time;
+    InputEventType type;
+    // BoardMode, cone size index and vertical mode (0 or 1) after the
+    // event
+    std::uint8_t mode;
+    std::uint8_t coneSize;
+    std::uint8_t vertical;
+    std::uint32_t code;
+    GridCell cursor;
+    GridCell point;
+    GridCell hit;
+    std::uint32_t reserved;
+};
+
+// The on-disk input log, in the byte order of the machine that wrote it:
+//
+//     InputLogHeader
+//     InputEvent      events[count]    56 bytes each
+struct InputLogHeader
+{
+    static const std::uint32_t MAGIC = 0x504e4945; // "EINP" read as little endian
+    static const std::uint32_t VERSION = 2;
+
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t count;
+    std::uint32_t reserved;
+};
+
+// Appends input events to a log file as they happen. The header is written
+// with a count of zero and filled in by stop(), so a log cut short by a
+// crash is read as empty rather than as garbage.
+class InputRecorder
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    InputRecorder();
+    ~InputRecorder();
+
+    InputRecorder(const InputRecorder &) = delete;
+    InputRecorder &operator=(const InputRecorder &) = delete;
+
+    bool recording() const { return m_out != nullptr; }
+    std::size_t size() const { return m_count; }
+
+    // Starts a new log at path, returning false with a message in error
+    // on failure
+    bool start(const std::string &path, std::string &error);
+
+    // Appends event, with its time filled in. Does nothing unless
+    // recording; a failed write shows up in stop().
+    void record(InputEvent event);
+
+    // Finishes the log, returning false with a message in error if any of
+    // it couldn't be written
+    bool stop(std::string &error);
+
+private:
+    std::FILE *m_out;
+    std::string m_path;
+    Clock::time_point m_start;
+    std::uint32_t m_count;
+    bool m_failed;
+};
+
+// Reads the whole log at path into events, returning false with a message
+// in error if it can't be read or isn't an input log of this version
+bool loadInputLog(const std::string &path, std::vector<InputEvent> &events, std::string &error);
+
+#endif // #ifndef __InputLog_h_
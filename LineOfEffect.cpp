@@ -0,0 +1,170 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    LineOfEffect.cpp
+-----------------------------------------------------------------------------
+*/
+#include "LineOfEffect.h"
+
+#include <algorithm>
+
+//-------------------------------------------------------------------------------------
+// Walks the segment from the grid point {0, 0, 0} to the centre of target
+// and calls visit(cell) for every cell it passes through the inside of,
+// target included. Working in half cells, the segment runs along d = 2 *
+// target + 1, whose parts are odd and so never zero, and it crosses the
+// n-th boundary along axis i at a fraction 2n / |d[i]| of its length.
+// Those are compared by cross multiplying, so ties, where the segment goes
+// through an edge or corner, are exact and stepped over together.
+template <typename Visitor>
+static void walkSegment(const GridCell &target, Visitor visit)
+{
+    const int t[3] = { target.x, target.y, target.z };
+    long d[3];
+    int cell[3];
+    long crossed[3];
+    for (int i = 0; i < 3; i++) {
+        d[i] = std::labs(2L * t[i] + 1);
+        // the cell the segment starts in, on the side it leaves towards
+        cell[i] = t[i] >= 0 ? 0 : -1;
+        // boundaries crossed so far along axis i, counting the next one
+        crossed[i] = 1;
+    }
+
+    visit(GridCell(cell[0], cell[1], cell[2]));
+    while (cell[0] != t[0] || cell[1] != t[1] || cell[2] != t[2]) {
+        // the soonest boundary is the smallest crossed[i] / d[i], among
+        // the axes not already at the target
+        int first = -1;
+        for (int i = 0; i < 3; i++) {
+            if (cell[i] != t[i] && (first < 0 || crossed[i] * d[first] < crossed[first] * d[i])) {
+                first = i;
+            }
+        }
+        const long num = crossed[first], den = d[first];
+        for (int i = 0; i < 3; i++) {
+            if (cell[i] != t[i] && crossed[i] * den == num * d[i]) {
+                cell[i] += t[i] >= 0 ? 1 : -1;
+                crossed[i]++;
+            }
+        }
+        visit(GridCell(cell[0], cell[1], cell[2]));
+    }
+}
+
+ShadowTable::ShadowTable(int radius)
+    : m_radius(radius),
+      m_extent(2 * radius + 1)
+{
+    const std::size_t count = std::size_t(m_extent) * m_extent * m_extent;
+
+    // Count the shadow of every cell first, so the table is one array
+    std::vector<std::uint32_t> sizes(count + 1, 0);
+    for (std::size_t target = 0; target < count; target++) {
+        walkSegment(offset(target), [&](const GridCell &c) {
+            sizes[index(c)]++;
+        });
+    }
+
+    m_begin.resize(count + 1);
+    std::uint32_t total = 0;
+    for (std::size_t i = 0; i <= count; i++) {
+        m_begin[i] = total;
+        total += sizes[i];
+    }
+
+    m_shadows.resize(std::max<std::uint32_t>(total, 1));
+    std::vector<std::uint32_t> fill(m_begin.begin(), m_begin.end() - 1);
+    for (std::size_t target = 0; target < count; target++) {
+        walkSegment(offset(target), [&](const GridCell &c) {
+            m_shadows[fill[index(c)]++] = std::uint32_t(target);
+        });
+    }
+}
+
+GridCell ShadowTable::offset(std::size_t index) const
+{
+    return GridCell(int(index % m_extent) - m_radius,
+                    int(index / m_extent % m_extent) - m_radius,
+                    int(index / m_extent / m_extent) - m_radius);
+}
+
+//-------------------------------------------------------------------------------------
+ShadowCache::ShadowCache(std::size_t capacity)
+    : m_capacity(std::max<std::size_t>(capacity, 1))
+{
+}
+
+std::shared_ptr<const ShadowTable> ShadowCache::get(int radius)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        for (auto it = m_tables.begin(); it != m_tables.end(); ++it) {
+            if ((*it)->radius() == radius) {
+                m_tables.splice(m_tables.begin(), m_tables, it);
+                return m_tables.front();
+            }
+        }
+    }
+
+    // Build outside the lock, as AreaCache::get() does
+    std::shared_ptr<const ShadowTable> table = std::make_shared<ShadowTable>(radius);
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    for (auto it = m_tables.begin(); it != m_tables.end(); ++it) {
+        if ((*it)->radius() == radius) {
+            m_tables.splice(m_tables.begin(), m_tables, it);
+            return m_tables.front();
+        }
+    }
+
+    m_tables.push_front(table);
+    if (m_tables.size() > m_capacity) {
+        m_tables.pop_back();
+    }
+    return table;
+}
+
+//-------------------------------------------------------------------------------------
+LineOfEffect::LineOfEffect(std::shared_ptr<const ShadowTable> table)
+    : m_table(table),
+      m_walls(0),
+      m_blockers(table->cellCount(), 0)
+{
+}
+
+template <typename Walls>
+void LineOfEffect::resetFrom(const GridCell &origin, const Walls &walls)
+{
+    m_origin = origin;
+    // with no walls in the box, nothing is blocked already
+    if (m_walls) {
+        std::fill(m_blockers.begin(), m_blockers.end(), 0);
+        m_walls = 0;
+    }
+
+    // Most origins have no wall anywhere near them
+    const int r = m_table->radius();
+    if (!walls.maybeSet(GridCell(origin.x - r, origin.y - r, origin.z - r),
+                        GridCell(origin.x + r, origin.y + r, origin.z + r))) {
+        return;
+    }
+
+    for (std::size_t i = 0; i < m_table->cellCount(); i++) {
+        if (walls.test(origin + m_table->offset(i))) {
+            m_walls++;
+            for (const std::uint32_t *s = m_table->shadowBegin(i); s != m_table->shadowEnd(i); ++s) {
+                m_blockers[*s]++;
+            }
+        }
+    }
+}
+
+void LineOfEffect::reset(const GridCell &origin, const OccupancyGrid &walls)
+{
+    resetFrom(origin, walls);
+}
+
+void LineOfEffect::reset(const GridCell &origin, const OccupancyGrid::Window &walls)
+{
+    resetFrom(origin, walls);
+}
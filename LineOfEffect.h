@@ -0,0 +1,157 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    LineOfEffect.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __LineOfEffect_h_
+#define __LineOfEffect_h_
+
+#include "OccupancyGrid.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// For one radius, the shadow a wall casts from an area origin: every cell
+// of the (2 * radius + 1)^3 template box whose line of effect passes
+// through the wall's cell. A cell has line of effect when the segment from
+// the origin (a grid point) to the cell's centre crosses no wall. Passing
+// exactly through an edge or corner between cells doesn't touch them.
+//
+// A wall's own cell is part of its shadow, so walls are never covered.
+class ShadowTable
+{
+public:
+    explicit ShadowTable(int radius);
+
+    ShadowTable(const ShadowTable &) = delete;
+    ShadowTable &operator=(const ShadowTable &) = delete;
+
+    int radius() const { return m_radius; }
+    unsigned extent() const { return m_extent; }
+    std::size_t cellCount() const { return m_begin.size() - 1; }
+
+    // Box index of offset, or cellCount() if it is outside the box
+    inline std::size_t index(const GridCell &offset) const;
+    GridCell offset(std::size_t index) const;
+
+    // The box indices shadowed by a wall at box index i
+    const std::uint32_t *shadowBegin(std::size_t i) const { return &m_shadows[0] + m_begin[i]; }
+    const std::uint32_t *shadowEnd(std::size_t i) const { return &m_shadows[0] + m_begin[i + 1]; }
+
+private:
+    int m_radius;
+    unsigned m_extent;
+    // m_shadows[m_begin[i], m_begin[i + 1]) is the shadow of box index i
+    std::vector<std::uint32_t> m_begin;
+    std::vector<std::uint32_t> m_shadows;
+};
+
+// Keeps the ShadowTables of the last few radii asked for, dropping the
+// least recently used one when full, as AreaCache does for areas. Safe to
+// share between threads.
+class ShadowCache
+{
+public:
+    explicit ShadowCache(std::size_t capacity = 4);
+
+    // The table for radius (in cells), built on first use
+    std::shared_ptr<const ShadowTable> get(int radius);
+
+private:
+    std::mutex m_lock;
+    std::size_t m_capacity;
+    // most recently used first
+    std::list<std::shared_ptr<const ShadowTable> > m_tables;
+};
+
+// Which cells around one origin have line of effect, kept as a count per
+// cell of the walls shadowing it. Moving the origin recomputes the whole
+// box; adding or removing a wall only touches that wall's shadow.
+class LineOfEffect
+{
+public:
+    explicit LineOfEffect(std::shared_ptr<const ShadowTable> table);
+
+    const GridCell &origin() const { return m_origin; }
+    int radius() const { return m_table->radius(); }
+    // Walls in the box around the origin. With none, every cell is visible.
+    std::size_t wallCount() const { return m_walls; }
+
+    // Recomputes every cell for a new origin
+    void reset(const GridCell &origin, const OccupancyGrid &walls);
+    // As above, through a window on the walls, which unlike the grid can
+    // be read from several threads at once. The window must cover the box
+    // around origin.
+    void reset(const GridCell &origin, const OccupancyGrid::Window &walls);
+
+    // Updates for a wall added or removed at cell, which must be the only
+    // change to walls since the last update. Calls flipped(offset) for
+    // every cell, relative to the origin, that gained or lost line of
+    // effect.
+    template <typename Visitor>
+    void addWall(const GridCell &cell, Visitor flipped);
+    template <typename Visitor>
+    void removeWall(const GridCell &cell, Visitor flipped);
+
+    // Does the cell at offset from the origin have line of effect? Cells
+    // outside the box always do.
+    bool visible(const GridCell &offset) const {
+        std::size_t i = m_table->index(offset);
+        return i == m_table->cellCount() || m_blockers[i] == 0;
+    }
+
+private:
+    template <typename Walls>
+    void resetFrom(const GridCell &origin, const Walls &walls);
+
+    std::shared_ptr<const ShadowTable> m_table;
+    GridCell m_origin;
+    std::size_t m_walls;
+    std::vector<std::uint16_t> m_blockers;
+};
+
+std::size_t ShadowTable::index(const GridCell &offset) const
+{
+    unsigned x = offset.x + m_radius;
+    unsigned y = offset.y + m_radius;
+    unsigned z = offset.z + m_radius;
+    if (x >= m_extent || y >= m_extent || z >= m_extent) {
+        return cellCount();
+    }
+    return (std::size_t(z) * m_extent + y) * m_extent + x;
+}
+
+template <typename Visitor>
+void LineOfEffect::addWall(const GridCell &cell, Visitor flipped)
+{
+    std::size_t i = m_table->index(cell - m_origin);
+    if (i == m_table->cellCount()) {
+        return;
+    }
+    m_walls++;
+    for (const std::uint32_t *s = m_table->shadowBegin(i); s != m_table->shadowEnd(i); ++s) {
+        if (m_blockers[*s]++ == 0) {
+            flipped(m_table->offset(*s));
+        }
+    }
+}
+
+template <typename Visitor>
+void LineOfEffect::removeWall(const GridCell &cell, Visitor flipped)
+{
+    std::size_t i = m_table->index(cell - m_origin);
+    if (i == m_table->cellCount()) {
+        return;
+    }
+    m_walls--;
+    for (const std::uint32_t *s = m_table->shadowBegin(i); s != m_table->shadowEnd(i); ++s) {
+        if (--m_blockers[*s] == 0) {
+            flipped(m_table->offset(*s));
+        }
+    }
+}
+
+#endif // #ifndef __LineOfEffect_h_
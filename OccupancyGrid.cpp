@@ -0,0 +1,129 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    OccupancyGrid.cpp
+-----------------------------------------------------------------------------
+*/
+#include "OccupancyGrid.h"
+
+#include <algorithm>
+#include <cstring>
+
+//-------------------------------------------------------------------------------------
+OccupancyGrid::OccupancyGrid()
+    : m_lastValid(false),
+      m_lastKey(0),
+      m_last(nullptr)
+{
+}
+
+void OccupancyGrid::set(const GridCell &cell)
+{
+    const GridCell c = chunkOf(cell);
+    auto inserted = m_chunks.insert(std::make_pair(packCell(c.x, c.y, c.z), Chunk()));
+    Chunk &chunk = inserted.first->second;
+    if (inserted.second) {
+        std::memset(chunk.bits, 0, sizeof(chunk.bits));
+        // test() may have cached this chunk as empty
+        m_lastValid = false;
+    }
+
+    const unsigned i = bit(cell);
+    chunk.bits[i >> 6] |= std::uint64_t(1) << (i & 63);
+}
+
+void OccupancyGrid::reset(const GridCell &cell)
+{
+    const GridCell c = chunkOf(cell);
+    auto it = m_chunks.find(packCell(c.x, c.y, c.z));
+    if (it != m_chunks.end()) {
+        const unsigned i = bit(cell);
+        it->second.bits[i >> 6] &= ~(std::uint64_t(1) << (i & 63));
+    }
+}
+
+void OccupancyGrid::clear()
+{
+    m_chunks.clear();
+    m_lastValid = false;
+}
+
+bool OccupancyGrid::maybeSet(const GridCell &lo, const GridCell &hi) const
+{
+    const GridCell clo = chunkOf(lo), chi = chunkOf(hi);
+    for (int z = clo.z; z <= chi.z; z++) {
+        for (int y = clo.y; y <= chi.y; y++) {
+            for (int x = clo.x; x <= chi.x; x++) {
+                auto it = m_chunks.find(packCell(x, y, z));
+                if (it == m_chunks.end()) {
+                    continue;
+                }
+                for (std::uint64_t word : it->second.bits) {
+                    if (word) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+//-------------------------------------------------------------------------------------
+OccupancyGrid::Window::Window(const OccupancyGrid &grid, const GridCell &lo, const GridCell &hi)
+    : m_lo(chunkOf(lo))
+{
+    const GridCell top = chunkOf(hi);
+    m_nx = top.x - m_lo.x + 1;
+    m_ny = top.y - m_lo.y + 1;
+    m_chunks.reserve(std::size_t(m_nx) * m_ny * (top.z - m_lo.z + 1));
+    for (int z = m_lo.z; z <= top.z; z++) {
+        for (int y = m_lo.y; y <= top.y; y++) {
+            for (int x = m_lo.x; x <= top.x; x++) {
+                auto it = grid.m_chunks.find(packCell(x, y, z));
+                m_chunks.push_back(it == grid.m_chunks.end() ? nullptr : &it->second);
+            }
+        }
+    }
+}
+
+bool OccupancyGrid::Window::maybeSet(const GridCell &lo, const GridCell &hi) const
+{
+    const GridCell clo = chunkOf(lo), chi = chunkOf(hi);
+    for (int z = clo.z; z <= chi.z; z++) {
+        for (int y = clo.y; y <= chi.y; y++) {
+            for (int x = clo.x; x <= chi.x; x++) {
+                const Chunk *chunk = chunkAt(GridCell(x * CHUNK_CELLS, y * CHUNK_CELLS, z * CHUNK_CELLS));
+                if (!chunk) {
+                    continue;
+                }
+                for (std::uint64_t word : chunk->bits) {
+                    if (word) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+std::uint64_t OccupancyGrid::Window::row(const GridCell &start, int width) const
+{
+    // A chunk row is 16 bits of one word, since CHUNK_CELLS is 16
+    std::uint64_t result = 0;
+    GridCell cell = start;
+    for (int k = 0; k < width; ) {
+        const int x = cell.x & (CHUNK_CELLS - 1);
+        const int take = std::min(CHUNK_CELLS - x, width - k);
+        const Chunk *chunk = chunkAt(cell);
+        if (chunk) {
+            const unsigned i = bit(cell);
+            std::uint64_t bits = chunk->bits[i >> 6] >> (i & 63);
+            bits &= (std::uint64_t(1) << take) - 1;
+            result |= bits << k;
+        }
+        k += take;
+        cell.x += take;
+    }
+    return result;
+}
@@ -0,0 +1,143 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    OccupancyGrid.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __OccupancyGrid_h_
+#define __OccupancyGrid_h_
+
+#include "GridMath.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Which cells are taken, as a bitset per chunk. Chunks are only allocated
+// once a cell in them is set, so empty space costs nothing.
+//
+// test() remembers the last chunk it looked in, since a ray or a template
+// walk stays in one chunk for many cells in a row. That makes it unsafe to
+// call from more than one thread at a time.
+class OccupancyGrid
+{
+    struct Chunk;
+
+public:
+    // The chunks overlapping the box [lo, hi], looked up once so testing a
+    // cell inside the box needs no hashing. Only valid while the grid has
+    // no chunks added or removed.
+    class Window
+    {
+    public:
+        Window(const OccupancyGrid &grid, const GridCell &lo, const GridCell &hi);
+
+        // cell must be inside the box
+        inline bool test(const GridCell &cell) const;
+
+        // As OccupancyGrid::maybeSet(), for a box [lo, hi] inside the
+        // window's box
+        bool maybeSet(const GridCell &lo, const GridCell &hi) const;
+
+        // Bit k is test(start + (k, 0, 0)), for the width cells from start,
+        // which must all be inside the box. width is at most 64.
+        std::uint64_t row(const GridCell &start, int width) const;
+
+    private:
+        const Chunk *chunkAt(const GridCell &cell) const {
+            const GridCell c = chunkOf(cell) - m_lo;
+            return m_chunks[(c.z * m_ny + c.y) * m_nx + c.x];
+        }
+
+        GridCell m_lo;
+        int m_nx, m_ny;
+        // nullptr for chunks with nothing set
+        std::vector<const Chunk *> m_chunks;
+    };
+
+    OccupancyGrid();
+
+    void set(const GridCell &cell);
+    void reset(const GridCell &cell);
+    void clear();
+
+    inline bool test(const GridCell &cell) const;
+
+    // False if no cell in the box [lo, hi] is set. Only whole chunks are
+    // looked at, so it can be true for a box that merely shares a chunk
+    // with a set cell.
+    bool maybeSet(const GridCell &lo, const GridCell &hi) const;
+
+    // Calls visit(cell) for every set cell, in no particular order
+    template <typename Visitor>
+    void forEach(Visitor visit) const;
+
+private:
+    static const int CHUNK_WORDS = CHUNK_CELLS * CHUNK_CELLS * CHUNK_CELLS / 64;
+
+    struct Chunk
+    {
+        std::uint64_t bits[CHUNK_WORDS];
+    };
+
+    // Bit index of cell within its chunk
+    static unsigned bit(const GridCell &cell) {
+        const int m = CHUNK_CELLS - 1;
+        return unsigned(((cell.z & m) << CHUNK_SHIFT | (cell.y & m)) << CHUNK_SHIFT | (cell.x & m));
+    }
+
+    std::unordered_map<std::uint64_t, Chunk> m_chunks;
+
+    mutable bool m_lastValid;
+    mutable std::uint64_t m_lastKey;
+    // nullptr if that chunk has nothing set
+    mutable const Chunk *m_last;
+};
+
+bool OccupancyGrid::test(const GridCell &cell) const
+{
+    const GridCell c = chunkOf(cell);
+    const std::uint64_t key = packCell(c.x, c.y, c.z);
+    if (!m_lastValid || key != m_lastKey) {
+        auto it = m_chunks.find(key);
+        m_last = it == m_chunks.end() ? nullptr : &it->second;
+        m_lastKey = key;
+        m_lastValid = true;
+    }
+
+    if (!m_last) {
+        return false;
+    }
+    const unsigned i = bit(cell);
+    return (m_last->bits[i >> 6] >> (i & 63)) & 1;
+}
+
+bool OccupancyGrid::Window::test(const GridCell &cell) const
+{
+    const Chunk *chunk = chunkAt(cell);
+    if (!chunk) {
+        return false;
+    }
+    const unsigned i = bit(cell);
+    return (chunk->bits[i >> 6] >> (i & 63)) & 1;
+}
+
+template <typename Visitor>
+void OccupancyGrid::forEach(Visitor visit) const
+{
+    const int m = CHUNK_CELLS - 1;
+    for (const auto &it : m_chunks) {
+        const GridCell c = unpackCell(it.first);
+        const GridCell corner(c.x * CHUNK_CELLS, c.y * CHUNK_CELLS, c.z * CHUNK_CELLS);
+        for (int w = 0; w < CHUNK_WORDS; w++) {
+            const std::uint64_t word = it.second.bits[w];
+            for (int k = 0; word && k < 64; k++) {
+                if ((word >> k) & 1) {
+                    const int i = w * 64 + k;
+                    visit(corner + GridCell(i & m, (i >> CHUNK_SHIFT) & m, i >> 2 * CHUNK_SHIFT));
+                }
+            }
+        }
+    }
+}
+
+#endif // #ifndef __OccupancyGrid_h_
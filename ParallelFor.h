@@ -0,0 +1,93 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    ParallelFor.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __ParallelFor_h_
+#define __ParallelFor_h_
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Number of workers parallelFor() will use, one per core
+inline unsigned parallelWorkerCount()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls body(worker, begin, end) over [0, count) in slices of at most grain
+// items, using every core. worker is in [0, parallelWorkerCount()), so the
+// body can keep per-worker results without locking.
+//
+// Each worker starts with a contiguous share of the slices and takes them
+// from the back of its own queue. A worker that runs dry steals from the
+// front of the others' queues, so uneven slices still balance out.
+template <typename Body>
+void parallelFor(std::size_t count, std::size_t grain, Body body)
+{
+    typedef std::pair<std::size_t, std::size_t> Range;
+    struct Queue {
+        std::mutex lock;
+        std::deque<Range> ranges;
+    };
+
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<std::size_t>(grain, 1);
+
+    std::size_t slices = (count + grain - 1) / grain;
+    unsigned workers = unsigned(std::min<std::size_t>(parallelWorkerCount(), slices));
+
+    std::vector<Queue> queues(workers);
+    for (std::size_t i = 0; i < slices; i++) {
+        queues[i * workers / slices].ranges.push_back(
+                    Range(i * grain, std::min(count, (i + 1) * grain)));
+    }
+
+    auto run = [&](unsigned self) {
+        for (;;) {
+            Range r;
+            bool found = false;
+            {
+                std::lock_guard<std::mutex> guard(queues[self].lock);
+                if (!queues[self].ranges.empty()) {
+                    r = queues[self].ranges.back();
+                    queues[self].ranges.pop_back();
+                    found = true;
+                }
+            }
+
+            for (unsigned i = 1; i < workers && !found; i++) {
+                Queue &victim = queues[(self + i) % workers];
+                std::lock_guard<std::mutex> guard(victim.lock);
+                if (!victim.ranges.empty()) {
+                    r = victim.ranges.front();
+                    victim.ranges.pop_front();
+                    found = true;
+                }
+            }
+
+            // nothing is ever added once started, so empty queues mean done
+            if (!found) {
+                return;
+            }
+            body(self, r.first, r.second);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < workers; i++) {
+        threads.push_back(std::thread(run, i));
+    }
+    run(0);
+    for (std::thread &t : threads) {
+        t.join();
+    }
+}
+
+#endif // #ifndef __ParallelFor_h_
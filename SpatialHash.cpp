@@ -0,0 +1,52 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    SpatialHash.cpp
+-----------------------------------------------------------------------------
+*/
+#include "SpatialHash.h"
+
+//-------------------------------------------------------------------------------------
+SpatialHash::SpatialHash(int bucketShift)
+    : m_bucketShift(std::min(bucketShift, LOCAL_BITS)),
+      m_size(0)
+{
+}
+
+void SpatialHash::insert(const GridCell &cell)
+{
+    const GridCell b(cell.x >> m_bucketShift, cell.y >> m_bucketShift, cell.z >> m_bucketShift);
+    Bucket &bucket = m_buckets[packCell(b.x, b.y, b.z)];
+    if (bucket.cells.empty()) {
+        const int size = 1 << m_bucketShift;
+        bucket.corner = GridCell(b.x * size, b.y * size, b.z * size);
+    }
+    bucket.cells.push_back(packLocal(cell, m_bucketShift));
+
+    if (m_size == 0) {
+        m_lo = m_hi = cell;
+    } else {
+        m_lo = GridCell(std::min(m_lo.x, cell.x), std::min(m_lo.y, cell.y), std::min(m_lo.z, cell.z));
+        m_hi = GridCell(std::max(m_hi.x, cell.x), std::max(m_hi.y, cell.y), std::max(m_hi.z, cell.z));
+    }
+    m_size++;
+}
+
+bool SpatialHash::bounds(GridCell &lo, GridCell &hi) const
+{
+    lo = m_lo;
+    hi = m_hi;
+    return m_size != 0;
+}
+
+void SpatialHash::clear()
+{
+    m_buckets.clear();
+    m_size = 0;
+}
+
+void SpatialHash::query(const GridCell &centre, int radius, std::vector<GridCell> &out) const
+{
+    query(centre, radius, [&out](const GridCell &c) {
+        out.push_back(c);
+    });
+}
@@ -0,0 +1,110 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    SpatialHash.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __SpatialHash_h_
+#define __SpatialHash_h_
+
+#include "GridMath.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Uniform grid over cells, hashed by bucket, so a query only touches the
+// cells stored in buckets that overlap the queried box. A cell may be
+// stored more than once. Cells are kept as LocalCells within their
+// bucket, so a query streams 4 bytes per cell, and buckets wholly inside
+// the box skip the bounds test.
+class SpatialHash
+{
+public:
+    // Buckets are 2^bucketShift cells along each axis, at most LOCAL_BITS
+    explicit SpatialHash(int bucketShift = 3);
+
+    void insert(const GridCell &cell);
+    void clear();
+
+    std::size_t size() const { return m_size; }
+
+    // The smallest box holding every stored cell, or false if there are none
+    bool bounds(GridCell &lo, GridCell &hi) const;
+
+    // Calls visit(cell) for every stored cell no more than radius cells
+    // away from centre along each axis
+    template <typename Visitor>
+    void query(const GridCell &centre, int radius, Visitor visit) const;
+
+    // Calls visit(cell) for every stored cell in the box [lo, hi]
+    template <typename Visitor>
+    void queryBox(const GridCell &lo, const GridCell &hi, Visitor visit) const;
+
+    // Calls visit(cell) for every stored cell
+    template <typename Visitor>
+    void forEach(Visitor visit) const;
+
+    // Appends every stored cell within radius of centre, as query() does
+    void query(const GridCell &centre, int radius, std::vector<GridCell> &out) const;
+
+private:
+    struct Bucket
+    {
+        GridCell corner;
+        std::vector<LocalCell> cells;
+    };
+
+    int m_bucketShift;
+    std::size_t m_size;
+    GridCell m_lo, m_hi;
+    std::unordered_map<std::uint64_t, Bucket> m_buckets;
+};
+
+template <typename Visitor>
+void SpatialHash::query(const GridCell &centre, int radius, Visitor visit) const
+{
+    queryBox(GridCell(centre.x - radius, centre.y - radius, centre.z - radius),
+             GridCell(centre.x + radius, centre.y + radius, centre.z + radius),
+             visit);
+}
+
+template <typename Visitor>
+void SpatialHash::queryBox(const GridCell &lo, const GridCell &hi, Visitor visit) const
+{
+    const int last = (1 << m_bucketShift) - 1;
+    for (int bz = lo.z >> m_bucketShift; bz <= hi.z >> m_bucketShift; bz++) {
+        for (int by = lo.y >> m_bucketShift; by <= hi.y >> m_bucketShift; by++) {
+            for (int bx = lo.x >> m_bucketShift; bx <= hi.x >> m_bucketShift; bx++) {
+                auto it = m_buckets.find(packCell(bx, by, bz));
+                if (it == m_buckets.end()) {
+                    continue;
+                }
+
+                const GridCell &corner = it->second.corner;
+                const bool inside = corner.x >= lo.x && corner.x + last <= hi.x &&
+                                    corner.y >= lo.y && corner.y + last <= hi.y &&
+                                    corner.z >= lo.z && corner.z + last <= hi.z;
+                for (LocalCell l : it->second.cells) {
+                    const GridCell c = unpackLocal(l, corner);
+                    if (inside || (c.x >= lo.x && c.x <= hi.x &&
+                                   c.y >= lo.y && c.y <= hi.y &&
+                                   c.z >= lo.z && c.z <= hi.z)) {
+                        visit(c);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename Visitor>
+void SpatialHash::forEach(Visitor visit) const
+{
+    for (const auto &it : m_buckets) {
+        for (LocalCell l : it.second.cells) {
+            visit(unpackLocal(l, it.second.corner));
+        }
+    }
+}
+
+#endif // #ifndef __SpatialHash_h_
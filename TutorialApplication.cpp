@@ -15,6 +15,11 @@ This source file is part of the
 -----------------------------------------------------------------------------
 */
 #include "TutorialApplication.h"
+#include "AllocationCounter.h"
+#include "ConeMesh.h"
+#include "ConeSolver.h"
+#include "EncounterFile.h"
+#include "VoxelRay.h"
 
 #include <OgreManualObject.h>
 #include <OgreRay.h>
@@ -22,16 +27,47 @@ This source file is part of the
 
 using namespace Ogre;
 
+// Cone meshes built per frame while the cones are being created
+static const std::size_t CONES_PER_FRAME = 4;
+
+// Most cells a vertical mode pick walks through, enough to cross the
+// streamed part of the board diagonally
+static const int PICK_STEPS = 3 * (2 * TutorialApplication::VIEW_CHUNKS + 1) * CHUNK_CELLS;
+
 //-------------------------------------------------------------------------------------
 TutorialApplication::TutorialApplication(void)
     : m_activeLevel(Vector3::UNIT_Y, 0),
       m_verticalMode(false),
-      m_pointNode(nullptr)
+      m_mode(NoneMode),
+      m_board(CONE_SIZE_COUNT),
+      m_creatures(nullptr),
+      m_grid(nullptr),
+      m_overlay(nullptr),
+      m_coverageMapDirty(true),
+      m_hasView(false),
+      m_coneCache(CONE_SIZE_COUNT),
+      m_coneSize(DEFAULT_CONE_SIZE),
+      m_futureRadius(0),
+      m_conesBuilt(0),
+      m_conesWanted(false),
+      m_coneProgress(nullptr),
+      m_pointNode(nullptr),
+      m_shownCones(0),
+      m_clippedCones(0),
+      m_clipCurrent(0),
+      m_mouseMoved(false),
+      m_conesDirty(false),
+      m_coneEvalTime(0),
+      m_detailsFrames(0),
+      m_detailsAllocations(0)
 {
 }
 //-------------------------------------------------------------------------------------
 TutorialApplication::~TutorialApplication(void)
 {
+    delete m_creatures;
+    delete m_grid;
+    delete m_overlay;
 }
 
 void TutorialApplication::chooseSceneManager()
@@ -42,92 +78,64 @@ void TutorialApplication::chooseSceneManager()
 void TutorialApplication::createFrameListener()
 {
     BaseApplication::createFrameListener();
-//    m_rayScnQuery = m_SceneMgr->createRayQuery(Ogre::Ray());
 }
 
 //-------------------------------------------------------------------------------------
-const std::vector<Vector3> make_cases() {
-    std::vector<Vector3> v;
-    for (int x = -1; x <= 1; x++) {
-        for (int y = -1; y <= 1; y++) {
-            for (int z = -1; z <= 1; z++) {
-                v.push_back(Vector3(x, y, z) *
-                            TutorialApplication::GRID_SPACING);
-            }
-        }
-    }
-
-    // remove the {0, 0, 0} case
-    v.erase(std::find(v.begin(), v.end(), Vector3(0, 0, 0)));
-    return v;
+// Cells are only turned into world space, and back, here at the edge of
+// the scene; everything else works on GridCells.
+
+// The grid point nearest v
+static inline GridCell toCell(const Vector3 &v) {
+    return GridCell(round(v.x / TutorialApplication::GRID_SPACING),
+                    round(v.y / TutorialApplication::GRID_SPACING),
+                    round(v.z / TutorialApplication::GRID_SPACING));
 }
 
-const std::vector<Vector3> TutorialApplication::CONE_CASES = make_cases();
-
-inline Real distance(Real x, Real y) {
-    return abs(x - y) + floor(std::min(x, y) * 1.5 / TutorialApplication::GRID_SPACING) * TutorialApplication::GRID_SPACING;
+// The cell whose floor square, on the level nearest v, holds v
+static inline GridCell cellAt(const Vector3 &v) {
+    return GridCell(floor(v.x / TutorialApplication::GRID_SPACING),
+                    round(v.y / TutorialApplication::GRID_SPACING),
+                    floor(v.z / TutorialApplication::GRID_SPACING));
 }
 
-inline Real distance3(Real _x, Real _y, Real _z) {
-    Real x(abs(_x)), y(abs(_y)), z(abs(_z));
-    Real c = std::min({x,y,z});
-    Real d2;
-    if (x == c) {
-        d2 = distance(y-c, z-c);
-    } else if (y == c) {
-        d2 = distance(x-c, z-c);
-    } else if (z == c) {
-        d2 = distance(x-c, y-c);
-    } else {
-        assert (false && "WTF MATH?!");
-    }
-
-    return d2 + floor(c * 1.75 / TutorialApplication::GRID_SPACING) * TutorialApplication::GRID_SPACING;
+// The world position of grid point c, the low corner of cell c
+static inline Vector3 toWorld(const GridCell &c) {
+    return Vector3(c.x, c.y, c.z) * TutorialApplication::GRID_SPACING;
 }
 
-void TutorialApplication::createCones(ManualObject *obj, std::vector<Vector3> &seen, SceneNode *parentNode, Vector3 pos, Vector3 dir)
+// Bakes every voxel of a cone into a single ManualObject, so showing the
+// cone is one draw call. Faces shared by two voxels of the cone are
+// skipped, which also stops the blended interior from being overdrawn.
+// With visible, the voxels it has no line of effect to are left out.
+void TutorialApplication::createConeMesh(SceneNode *parentNode, const OrientedCone &cone, const String &name,
+                                         const LineOfEffect *visible)
 {
-    if (std::find(seen.begin(), seen.end(), pos) != seen.end()) {
-        // we've already drawn this point
-        return;
-    }
-    seen.push_back(pos);
-
-    for (Vector3 c : CONE_CASES) {
-        if (c.angleBetween(dir) <= Degree(45)) {
-            Vector3 pNext = pos + c;
-            Real distance = distance3(pNext.x, pNext.y, pNext.z);
-            if (distance <= CONE_SIZE) {
-                createCones(obj, seen, parentNode, pNext, dir);
-            }
+    ManualObject *obj = m_SceneMgr->createManualObject(name);
+    obj->estimateVertexCount(cone.cellCount() * 8);
+    obj->estimateIndexCount(cone.cellCount() * 12);
+    obj->begin("Template/Red50", RenderOperation::OT_TRIANGLE_LIST);
+
+    uint32 vertex = 0;
+    auto keep = [visible](const GridCell &cell) { return !visible || visible->visible(cell); };
+    forEachConeFace(cone, keep, [&](const GridCell &normal, const GridCell *corners) {
+        for (int i = 0; i < 4; i++) {
+            obj->position(toWorld(corners[i]));
+            obj->normal(normal.x, normal.y, normal.z);
         }
-    }
+        obj->quad(vertex, vertex + 1, vertex + 2, vertex + 3);
+        vertex += 4;
+    });
 
-    Entity *cube = m_SceneMgr->createEntity(SceneManager::PT_CUBE);
-    cube->setMaterialName("Template/Red50");
-    SceneNode *node = parentNode->createChildSceneNode();
-    node->attachObject(cube);
-    Real offset = GRID_SPACING / 2;
-    node->setPosition(pos.x + offset, pos.y + offset, pos.z + offset);
-    node->scale(0.1, 0.1, 0.1);
+    obj->end();
+    parentNode->attachObject(obj);
 }
 
 void TutorialApplication::createScene(void)
 {
     m_SceneMgr->setAmbientLight(Ogre::ColourValue(0.7f, 0.7f, 0.7f));
 
-    // Render the bottom grid using lines
-    Ogre::ManualObject *man = m_SceneMgr->createManualObject("grid");
-    man->begin("BaseWhiteNoLighting", Ogre::RenderOperation::OT_LINE_LIST);
-    for (Real i = -GRID_SIZE + GRID_SPACING; i < GRID_SIZE; i += GRID_SPACING) {
-        man->position(i, 0, -GRID_SIZE);
-        man->position(i, 0, GRID_SIZE);
-
-        man->position(-GRID_SIZE, 0, i);
-        man->position(GRID_SIZE, 0, i);
-    }
-    man->end();
-    m_SceneMgr->getRootSceneNode()->attachObject(man);
+    // The floor grid is streamed in around the camera by updateView()
+    m_grid = new FloorGrid(m_SceneMgr, GRID_SPACING);
 
     // Create the cursor plane
     ManualObject *plane = m_SceneMgr->createManualObject("basePlane");
@@ -140,17 +148,220 @@ void TutorialApplication::createScene(void)
     m_cursorNode = m_SceneMgr->getRootSceneNode()->createChildSceneNode("cursorNode");
     m_cursorNode->attachObject(plane);
 
-    // Create all possible cones, so they can be shown later
+    m_creatures = new CreatureLayer(m_SceneMgr, GRID_SPACING);
+    m_overlay = new CoverageOverlay(m_SceneMgr, GRID_SPACING, OVERLAY_CELLS, OVERLAY_CELLS);
+
+    // Cone nodes are only built once the cones are first needed, but the
+    // templates for them are generated in the background right away
     m_pointNode = m_SceneMgr->getRootSceneNode()->createChildSceneNode("coneBase");
-    for (Vector3 coneDir : CONE_CASES) {
-        std::vector<Vector3> seenList;
-        SceneNode *childNode = m_pointNode->createChildSceneNode();
-        m_coneNodes.push_back(childNode);
-        createCones(nullptr, seenList, childNode,
-                    m_pointNode->getPosition(), coneDir);
+    prepareCones();
+}
+
+int TutorialApplication::coneRadius() const
+{
+    return CONE_RADII[m_coneSize];
+}
+
+// Generates the templates and line of effect table for the cone size in
+// the background. If those of another size are still being generated, this
+// size is left to updateConeTemplates() to start once they are done, as
+// dropping the running task's future would wait for it.
+void TutorialApplication::prepareCones()
+{
+    m_coneTemplates.reset();
+    if (m_coneFuture.valid()) {
+        return;
     }
-    assert (m_coneNodes.size() == CONE_CASES.size());
-    m_pointNode->setVisible(false, true);
+
+    ConeCache &cache = m_coneCache;
+    ShadowCache &shadows = m_board.shadowTables();
+    const int radius = coneRadius();
+    m_futureRadius = radius;
+    m_coneFuture = std::async(std::launch::async, [&cache, &shadows, radius]() {
+        cache.get(radius);
+        shadows.get(radius);
+    });
+}
+
+// Picks up the templates once the background task is done, or starts on
+// the current cone size if it changed while the task ran. Never waits.
+void TutorialApplication::updateConeTemplates()
+{
+    if (m_coneTemplates) {
+        return;
+    }
+    if (m_coneFuture.valid()) {
+        if (m_coneFuture.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        m_coneFuture.get();
+        if (m_futureRadius != coneRadius()) {
+            prepareCones();
+            return;
+        }
+    }
+    m_coneTemplates = m_coneCache.get(coneRadius());
+}
+
+bool TutorialApplication::conesReady() const
+{
+    return m_cones && m_conesBuilt == m_cones->size();
+}
+
+// Asks for the cone nodes to be (re)built, over the next few frames
+void TutorialApplication::requestConeNodes()
+{
+    m_conesWanted = true;
+    if (!conesReady() && !m_coneProgress) {
+        m_coneProgress = mTrayMgr->createProgressBar(OgreBites::TL_TOP, "ConeProgress",
+                                                     "Building cones", 300, 180);
+    }
+}
+
+// Builds a few more of the cone nodes, once they have been asked for and
+// their templates are done
+void TutorialApplication::updateConeNodes()
+{
+    if (!m_conesWanted || conesReady()) {
+        return;
+    }
+
+    // the cone material comes with the background resources
+    if (!mResourcesLoaded) {
+        m_coneProgress->setComment("Waiting for resources");
+        return;
+    }
+
+    if (!m_cones) {
+        if (!m_coneTemplates) {
+            m_coneProgress->setComment("Generating templates");
+            return;
+        }
+        m_cones = m_coneTemplates;
+        m_conesBuilt = 0;
+        m_clippedCones = 0;
+        m_clipCurrent = 0;
+    }
+
+    std::size_t end = std::min(m_conesBuilt + CONES_PER_FRAME, m_cones->size());
+    for (; m_conesBuilt < end; m_conesBuilt++) {
+        createConeNode(m_conesBuilt);
+    }
+    assert (m_coneNodes.size() >= m_conesBuilt);
+
+    if (conesReady()) {
+        mTrayMgr->destroyWidget(m_coneProgress);
+        m_coneProgress = nullptr;
+        m_conesDirty = true;
+        m_recorder.record(inputEvent(ConesReadyEvent));
+    } else {
+        m_coneProgress->setComment("Creating meshes");
+        m_coneProgress->setProgress(Real(m_conesBuilt) / m_cones->size());
+    }
+}
+
+// (Re)builds the mesh of cone i for the current cone size, without the
+// cells sight, if given, has no line of effect to. New cones start hidden,
+// rebuilt ones keep their visibility.
+void TutorialApplication::createConeNode(std::size_t i, const LineOfEffect *sight)
+{
+    String name = "cone" + StringConverter::toString(i);
+    bool visible = false;
+    if (i < m_coneNodes.size()) {
+        visible = m_coneNodes[i]->getAttachedObject(0)->isVisible();
+        m_coneNodes[i]->detachAllObjects();
+        m_SceneMgr->destroyManualObject(name);
+    } else {
+        m_coneNodes.push_back(m_pointNode->createChildSceneNode());
+    }
+
+    createConeMesh(m_coneNodes[i], (*m_cones)[i], name, sight);
+    m_coneNodes[i]->setVisible(visible);
+}
+
+bool TutorialApplication::frameRenderingQueued(const FrameEvent &evt)
+{
+    m_detailsFrames++;
+    if (!BaseApplication::frameRenderingQueued(evt)) {
+        return false;
+    }
+
+    updateView();
+    updateConeTemplates();
+    updateCoverageMap();
+    updateConeNodes();
+    updateCursor();
+    clipShownCones();
+    {
+        TraceScope scope("creatures");
+        m_creatures->update();
+    }
+    frameWorkDone();
+    return true;
+}
+
+// Scene nodes under node, node included
+static std::size_t countNodes(Node *node)
+{
+    std::size_t count = 1;
+    Node::ChildNodeIterator it = node->getChildIterator();
+    while (it.hasMoreElements()) {
+        count += countNodes(it.getNext());
+    }
+    return count;
+}
+
+void TutorialApplication::addDetails(StringVector &items)
+{
+    items.push_back("");
+    items.push_back("Entities");
+    items.push_back("Scene nodes");
+    items.push_back("Creatures");
+    items.push_back("Cone voxels");
+    items.push_back("Cone eval");
+    items.push_back("Allocs/frame");
+}
+
+void TutorialApplication::updateDetails()
+{
+    BaseApplication::updateDetails();
+
+    std::size_t entities = 0;
+    SceneManager::MovableObjectIterator it =
+            m_SceneMgr->getMovableObjectIterator(EntityFactory::FACTORY_TYPE_NAME);
+    while (it.hasMoreElements()) {
+        it.getNext();
+        entities++;
+    }
+    mDetailsPanel->setParamValue("Entities", StringConverter::toString(entities));
+    mDetailsPanel->setParamValue("Scene nodes",
+                                 StringConverter::toString(countNodes(m_SceneMgr->getRootSceneNode())));
+    mDetailsPanel->setParamValue("Creatures",
+                                 StringConverter::toString(m_board.ogres().size() + m_board.party().size()));
+
+    // the voxels of the cones on show, out of all of them
+    std::size_t shown = 0, total = 0;
+    if (m_cones) {
+        for (std::size_t i = 0; i < m_cones->size(); i++) {
+            total += (*m_cones)[i].cellCount();
+            if ((m_shownCones >> i) & 1) {
+                shown += (*m_cones)[i].cellCount();
+            }
+        }
+    }
+    mDetailsPanel->setParamValue("Cone voxels",
+                                 StringConverter::toString(shown) + " / " + StringConverter::toString(total));
+
+    const std::chrono::duration<double, std::micro> eval = m_coneEvalTime;
+    mDetailsPanel->setParamValue("Cone eval", StringConverter::toString(Real(eval.count()), 4) + " us");
+
+    const std::uint64_t allocations = allocationCount();
+    if (m_detailsFrames) {
+        const Real perFrame = Real(allocations - m_detailsAllocations) / m_detailsFrames;
+        mDetailsPanel->setParamValue("Allocs/frame", StringConverter::toString(perFrame, 4));
+    }
+    m_detailsAllocations = allocations;
+    m_detailsFrames = 0;
 }
 
 void TutorialApplication::createCamera()
@@ -159,6 +370,57 @@ void TutorialApplication::createCamera()
     mCameraMan->setStyle(OgreBites::CS_ORBIT);
 }
 
+// Moves the floor grid and the drawn creatures along with the camera, a
+// chunk at a time. The view is centred where the camera looks at the
+// floor, or under the camera if that is too far off.
+void TutorialApplication::updateView()
+{
+    const Real reach = VIEW_CHUNKS * CHUNK_CELLS * GRID_SPACING;
+    Ray ray = mCamera->getCameraToViewportRay(0.5f, 0.5f);
+    auto r = ray.intersects(Plane(Vector3::UNIT_Y, 0));
+    Vector3 centre = r.first && r.second < reach ? ray.getPoint(r.second)
+                                                 : mCamera->getDerivedPosition();
+
+    GridCell chunk = chunkOf(toCell(centre));
+    chunk.y = 0;
+    if (m_hasView && chunk == m_viewChunk) {
+        return;
+    }
+
+    TraceScope scope("view");
+    m_hasView = true;
+    m_viewChunk = chunk;
+    m_grid->setView(chunk, VIEW_CHUNKS);
+    m_creatures->setView(chunk, VIEW_CHUNKS);
+}
+
+// Recomputes the coverage overlay while it is on, if the view has moved or
+// the cone size or the creatures changed in a way add() doesn't cover.
+// After a change of cone size the old overlay stays up until the new
+// templates are generated in the background.
+void TutorialApplication::updateCoverageMap()
+{
+    if (!m_overlay->isVisible() || !m_coneTemplates) {
+        return;
+    }
+
+    if (!m_coverageMap || &m_coverageMap->areas() != m_coneTemplates.get()) {
+        m_coverageMap.reset(new ConeCoverageMap(m_coneTemplates));
+        m_coverageMapDirty = true;
+    }
+
+    const GridCell origin((m_viewChunk.x - VIEW_CHUNKS) * CHUNK_CELLS, 0,
+                          (m_viewChunk.z - VIEW_CHUNKS) * CHUNK_CELLS);
+    if (!m_coverageMapDirty && m_coverageMap->origin() == origin) {
+        return;
+    }
+
+    TraceScope scope("coverageMap");
+    m_coverageMap->reset(m_board.ogres(), origin, OVERLAY_CELLS, OVERLAY_CELLS);
+    m_overlay->update(*m_coverageMap);
+    m_coverageMapDirty = false;
+}
+
 Ray TutorialApplication::getMouseRay() {
     const OIS::MouseState s = mMouse->getMouseState();
     Viewport *vp = m_SceneMgr->getCurrentViewport();
@@ -171,11 +433,13 @@ Ray TutorialApplication::getMouseRay() {
 static std::size_t prevCone = 0;
 bool TutorialApplication::keyPressed(const OIS::KeyEvent &arg)
 {
+    BoardCommand command = NoCommand;
     switch (arg.key) {
     case OIS::KC_LSHIFT:
     case OIS::KC_RSHIFT:
         std::cout << "Entering vertical mode" << std::endl;
         m_verticalMode = true;
+        m_mouseMoved = true;
         break;
     case OIS::KC_1:
         m_mode = NoneMode;
@@ -191,18 +455,62 @@ bool TutorialApplication::keyPressed(const OIS::KeyEvent &arg)
         m_mode = WitchMode;
         m_cursorNode->setVisible(false);
         m_pointNode->setVisible(true, false);
+        m_conesDirty = true;
+        requestConeNodes();
+        break;
+    case OIS::KC_4:
+        m_mode = PartyMode;
+        m_cursorNode->setVisible(true);
+        m_pointNode->setVisible(false);
+        break;
+    case OIS::KC_5:
+        m_mode = WallMode;
+        m_cursorNode->setVisible(true);
+        m_pointNode->setVisible(false);
+        break;
+    case OIS::KC_O:
+        solveCones();
+        command = SolveCommand;
+        break;
+    case OIS::KC_H:
+        m_overlay->setVisible(!m_overlay->isVisible());
+        std::cout << "Coverage overlay " << (m_overlay->isVisible() ? "on" : "off") << std::endl;
+        break;
+    case OIS::KC_F6:
+        saveEncounter();
+        break;
+    case OIS::KC_F7:
+        toggleRecording();
+        break;
+    case OIS::KC_F9:
+        loadEncounter();
+        command = LoadEncounterCommand;
+        break;
+    case OIS::KC_C:
+        m_coneSize = (m_coneSize + 1) % CONE_SIZE_COUNT;
+        std::cout << "Cone size is now " << coneRadius() * GRID_SPACING << std::endl;
+        m_cones.reset();
+        prepareCones();
+        if (m_conesWanted) {
+            requestConeNodes();
+        }
         break;
     case OIS::KC_I:
-        m_coneNodes[prevCone]->setVisible(false, true);
+        if (!conesReady()) {
+            requestConeNodes();
+            break;
+        }
+        showCones(m_shownCones & ~(std::uint32_t(1) << prevCone));
         prevCone++;
-        if (prevCone == CONE_CASES.size()) {
+        if (prevCone == m_cones->size()) {
             prevCone = 0;
         }
         std::cout << "setting " << m_coneNodes[prevCone] << " visible" << std::endl;
-        m_coneNodes[prevCone]->setVisible(true, true);
+        showCones(m_shownCones | std::uint32_t(1) << prevCone);
         break;
     }
 
+    m_recorder.record(inputEvent(KeyPressedEvent, command));
     return BaseApplication::keyPressed(arg);
 }
 
@@ -211,7 +519,9 @@ bool TutorialApplication::keyReleased(const OIS::KeyEvent &arg)
     if (arg.key == OIS::KC_LSHIFT || arg.key == OIS::KC_RSHIFT) {
         std::cout << "Exiting vertical mode" << std::endl;
         m_verticalMode = false;
+        m_mouseMoved = true;
     }
+    m_recorder.record(inputEvent(KeyReleasedEvent));
     return BaseApplication::keyReleased(arg);
 }
 
@@ -224,76 +534,343 @@ bool TutorialApplication::mouseMoved(const OIS::MouseEvent &arg)
 //              << arg.state.Z.abs << ")" << std::endl;
 //    std::cout << "plane at Y = " << m_activeLevel.d << std::endl;
 
-    Ray mouseRay = getMouseRay();
+    // Picking is done once a frame in updateCursor(), however many mouse
+    // events come in before then
+    m_mouseMoved = true;
+    return ret;
+}
 
-    if (m_verticalMode) {
-        // ignored for now, untill I figure out how to make it intuitive
-    } else {
-        auto r = mouseRay.intersects(m_activeLevel);
-        if (r.first) {
-            auto pos = mouseRay.getPoint(r.second);
-            auto gridPos =
-                    Vector3(floor(pos.x / GRID_SPACING) * GRID_SPACING,
-                            pos.y,
-                            floor(pos.z / GRID_SPACING) * GRID_SPACING);
-            m_cursorNode->setPosition(gridPos);
-            auto pointPos =
-                    Vector3(round(pos.x / GRID_SPACING) * GRID_SPACING,
-                            pos.y,
-                            round(pos.z / GRID_SPACING) * GRID_SPACING);
-            m_pointNode->setPosition(pointPos);
-
-            if (m_mode == WitchMode) {
-                for (std::size_t i = 0; i < CONE_CASES.size(); i++) {
-                    auto c = CONE_CASES[i];
-                    bool containsCreatures = true;
-                    for (Vector3 creature : m_ogres) {
-                        Vector3 dir = creature - gridPos;
-
-                        // cone is facing wrong way for creature
-                        if (dir.angleBetween(c) > Degree(45)) {
-                            containsCreatures = false;
-                            break;
-                        }
-
-                        // creature too far away for cone
-                        if (distance3(dir.x, dir.y, dir.z) > CONE_SIZE) {
-                            containsCreatures = false;
-                        }
-                    }
-
-                    if (containsCreatures) {
-                        m_coneNodes[i]->setVisible(true);
-                    } else {
-                        m_coneNodes[i]->setVisible(false);
-                    }
-                }
+// Moves the cursor to the cell under the mouse, if the mouse has moved
+// since the last frame, and re-evaluates the cones if the cone origin or
+// the board has changed
+void TutorialApplication::updateCursor()
+{
+    if (m_mouseMoved) {
+        TraceScope scope("mouse.pick");
+        m_mouseMoved = false;
+        Ray mouseRay = getMouseRay();
+
+        bool picked = false;
+        GridCell cursorCell, pointCell, hitCell;
+        if (m_verticalMode) {
+            // Walk the ray through the cells until it meets a creature or
+            // the floor. The cursor goes in the empty cell in front of it,
+            // and the cone origin on the nearest corner of the face hit.
+            const Vector3 o = mouseRay.getOrigin() / GRID_SPACING;
+            const Vector3 d = mouseRay.getDirection();
+            const double origin[3] = { o.x, o.y, o.z };
+            const double dir[3] = { d.x, d.y, d.z };
+            const OccupancyGrid &occupied = m_board.occupied();
+            const OccupancyGrid &walls = m_board.walls();
+            VoxelHit hit;
+            if (castVoxelRay(origin, dir, PICK_STEPS, [&occupied, &walls](const GridCell &c) {
+                    return c.y < 0 || occupied.test(c) || walls.test(c);
+                }, hit)) {
+                picked = true;
+                cursorCell = hit.before;
+                hitCell = hit.cell;
+                pointCell = toCell(mouseRay.getPoint(Real(hit.distance) * GRID_SPACING));
+            }
+        } else {
+            auto r = mouseRay.intersects(m_activeLevel);
+            if (r.first) {
+                auto pos = mouseRay.getPoint(r.second);
+                picked = true;
+                cursorCell = cellAt(pos);
+                pointCell = toCell(pos);
+                hitCell = cursorCell;
             }
         }
+
+        // still on the same cell, so there is nothing to update
+        if (picked) {
+            m_hitCell = hitCell;
+        }
+        if (picked && (cursorCell != m_cursorCell || pointCell != m_pointCell)) {
+            m_cursorCell = cursorCell;
+            m_pointCell = pointCell;
+            m_cursorNode->setPosition(toWorld(cursorCell));
+            moveConeOrigin(pointCell);
+            m_conesDirty = true;
+        }
+        if (picked) {
+            m_recorder.record(inputEvent(PickedEvent));
+        }
+    }
+
+    if (m_conesDirty && m_mode == WitchMode && conesReady()) {
+        TraceScope scope("mouse.cones");
+        m_conesDirty = false;
+
+        // A cone is shown when it covers every troll on the board, so none
+        // is while a troll is out of line of effect from the origin
+        const FrameTrace::Clock::time_point begin = FrameTrace::Clock::now();
+        showCones(m_board.evaluate(m_cones, m_pointCell));
+        m_coneEvalTime = FrameTrace::Clock::now() - begin;
     }
-    return ret;
 }
 
 bool TutorialApplication::mouseReleased(const OIS::MouseEvent &arg, OIS::MouseButtonID id)
 {
-    if (m_mode == TrollMode) {
-        const Vector3 p = m_cursorNode->getPosition();
-        m_ogres.push_back(p);
+    // place the creature where the cursor is now, not where it was at the
+    // start of the frame
+    updateCursor();
+    m_recorder.record(inputEvent(ClickedEvent, id));
+
+    // the creature mesh and materials come with the background resources
+    if ((m_mode == TrollMode || m_mode == PartyMode) && mResourcesLoaded) {
+        // one creature to a cell
+        const GridCell cell = m_cursorCell;
+        if (m_mode == PartyMode) {
+            if (m_board.addCreature(cell, AllyCreature)) {
+                m_creatures->add(cell, CreatureLayer::Ally);
+            }
+        } else if (m_board.addCreature(cell, TrollCreature)) {
+            m_creatures->add(cell, CreatureLayer::Troll);
+            if (m_coverageMap && !m_coverageMapDirty) {
+                GridCell lo, hi;
+                if (m_coverageMap->add(cell, lo, hi)) {
+                    m_overlay->update(*m_coverageMap, lo, hi);
+                }
+            }
+            m_conesDirty = true;
+        }
+        // the cell under the cursor is now taken, so pick again
+        if (m_verticalMode) {
+            m_mouseMoved = true;
+        }
+    } else if (m_mode == WallMode && mResourcesLoaded) {
+        toggleWall();
+    }
 
-        Ogre::Entity *troll = m_SceneMgr->createEntity("ogrehead.mesh");
-        Vector3 bounds = troll->getBoundingBox().getSize();
-        Real dim = std::max({bounds.x, bounds.y, bounds.z});
-        Real scale = GRID_SPACING / dim;
-        bounds = bounds * scale * 0.5f;
+    return BaseApplication::mouseReleased(arg, id);
+}
 
-        Ogre::SceneNode *node = m_SceneMgr->getRootSceneNode()->createChildSceneNode();
-        node->setPosition(p.x + bounds.x, p.y + bounds.y, p.z + bounds.z);
-//        node->showBoundingBox(true);
-        node->scale(scale, scale, scale);
-        node->attachObject(troll);
+// Removes the wall the cursor is on, or in vertical mode the one it is
+// in front of, or else builds one in the cursor cell if it is empty
+void TutorialApplication::toggleWall()
+{
+    GridCell cell = m_verticalMode ? m_hitCell : m_cursorCell;
+    bool changed = false;
+    if (!m_board.walls().test(cell)) {
+        cell = m_cursorCell;
+        if (m_board.addWall(cell, changed)) {
+            m_creatures->add(cell, CreatureLayer::Wall);
+            m_clipCurrent = 0;
+        }
+    } else if (m_board.removeWall(cell, changed)) {
+        m_creatures->remove(cell, CreatureLayer::Wall);
+        m_clipCurrent = 0;
+    }
+    if (changed) {
+        m_conesDirty = true;
     }
 
-    return BaseApplication::mouseReleased(arg, id);
+    if (m_verticalMode) {
+        m_mouseMoved = true;
+    }
+}
+
+// Starts recording the input to INPUT_FILE, with what is on the board
+// now, or stops and finishes the file
+void TutorialApplication::toggleRecording()
+{
+    std::string error;
+    if (m_recorder.recording()) {
+        const std::size_t count = m_recorder.size();
+        if (m_recorder.stop(error)) {
+            std::cout << "Recorded " << count << " input events to " << INPUT_FILE << std::endl;
+        } else {
+            std::cout << "Couldn't record the input: " << error << std::endl;
+        }
+        return;
+    }
+
+    // clicks and F9 do nothing until then, and a replay can't tell
+    if (!mResourcesLoaded) {
+        std::cout << "Input can't be recorded until the resources are loaded" << std::endl;
+        return;
+    }
+    if (!m_recorder.start(INPUT_FILE, error)) {
+        std::cout << "Couldn't record the input: " << error << std::endl;
+        return;
+    }
+
+    InputEvent e = inputEvent(CreatureEvent, TrollCreature);
+    m_board.ogres().forEach([&](const GridCell &c) {
+        e.cursor = c;
+        m_recorder.record(e);
+    });
+    e.code = AllyCreature;
+    m_board.party().forEach([&](const GridCell &c) {
+        e.cursor = c;
+        m_recorder.record(e);
+    });
+    e = inputEvent(WallEvent);
+    m_board.walls().forEach([&](const GridCell &c) {
+        e.cursor = c;
+        m_recorder.record(e);
+    });
+    if (conesReady()) {
+        m_recorder.record(inputEvent(ConesReadyEvent));
+    }
+    std::cout << "Recording the input to " << INPUT_FILE << ", F7 to stop" << std::endl;
+}
+
+// An event of type in the current state, for the recorder
+InputEvent TutorialApplication::inputEvent(InputEventType type, std::uint32_t code) const
+{
+    InputEvent e;
+    e.time = 0;
+    e.type = type;
+    e.mode = std::uint8_t(m_mode);
+    e.coneSize = std::uint8_t(m_coneSize);
+    e.vertical = m_verticalMode;
+    e.code = code;
+    e.cursor = m_cursorCell;
+    e.point = m_pointCell;
+    e.hit = m_hitCell;
+    return e;
+}
+
+void TutorialApplication::solveCones()
+{
+    if (!conesReady()) {
+        std::cout << "Cones are still being built" << std::endl;
+        requestConeNodes();
+        return;
+    }
+
+    std::vector<ConePlacement> best = m_board.solve(*m_cones, SOLVER_RESULTS);
+
+    for (const ConePlacement &p : best) {
+        std::cout << "cone at (" << p.origin.x << "," << p.origin.y << "," << p.origin.z
+                  << ") facing " << p.direction
+                  << " covers " << p.covered << " trolls" << std::endl;
+    }
+
+    if (!best.empty()) {
+        moveConeOrigin(best.front().origin);
+        m_pointNode->setVisible(true, false);
+    }
+    showCones(best.empty() ? 0 : std::uint32_t(1) << best.front().direction);
+}
+
+// Shows the cones whose bit is set in cones and hides the rest, touching
+// only the nodes that change
+void TutorialApplication::showCones(std::uint32_t cones)
+{
+    std::uint32_t changed = cones ^ m_shownCones;
+    for (std::size_t i = 0; changed; i++, changed >>= 1) {
+        if ((changed & 1) && i < m_coneNodes.size()) {
+            m_coneNodes[i]->setVisible((cones >> i) & 1);
+        }
+    }
+    m_shownCones = cones;
+}
+
+void TutorialApplication::moveConeOrigin(const GridCell &origin)
+{
+    m_pointNode->setPosition(toWorld(origin));
+    m_coneOrigin = origin;
+    m_clipCurrent = 0;
+}
+
+// Rebuilds the meshes of the shown cones without the cells the cone origin
+// has no line of effect to, as Board::evaluate() and Board::solve() count
+// them. Only meshes built for another origin or before the walls last
+// changed are looked at, and of those only the ones with cells to leave
+// out, or with cells left out before, are rebuilt.
+void TutorialApplication::clipShownCones()
+{
+    std::uint32_t stale = m_shownCones & ~m_clipCurrent;
+    if (!stale || !m_cones) {
+        return;
+    }
+
+    TraceScope scope("cones.clip");
+    if (!m_coneSight || m_coneSight->radius() != m_cones->radius()) {
+        m_coneSight.reset(new LineOfEffect(m_board.shadowTables().get(m_cones->radius())));
+    }
+    m_coneSight->reset(m_coneOrigin, m_board.walls());
+    const bool blocked = m_coneSight->wallCount() != 0;
+    for (std::size_t i = 0; stale; i++, stale >>= 1) {
+        const std::uint32_t bit = std::uint32_t(1) << i;
+        if (!(stale & 1) || i >= m_conesBuilt) {
+            continue;
+        }
+        if (blocked || (m_clippedCones & bit)) {
+            createConeNode(i, blocked ? m_coneSight.get() : nullptr);
+            m_clippedCones = blocked ? m_clippedCones | bit : m_clippedCones & ~bit;
+        }
+        m_clipCurrent |= bit;
+    }
+}
+
+void TutorialApplication::saveEncounter()
+{
+    std::vector<GridCell> cells;
+    std::vector<CreatureType> types;
+    cells.reserve(m_board.ogres().size() + m_board.party().size());
+    types.reserve(m_board.ogres().size() + m_board.party().size());
+    m_board.ogres().forEach([&](const GridCell &c) {
+        cells.push_back(c);
+        types.push_back(TrollCreature);
+    });
+    m_board.party().forEach([&](const GridCell &c) {
+        cells.push_back(c);
+        types.push_back(AllyCreature);
+    });
+
+    std::string error;
+    if (::saveEncounter(ENCOUNTER_FILE, cells, types, error)) {
+        std::cout << "Saved " << cells.size() << " creatures to " << ENCOUNTER_FILE << std::endl;
+    } else {
+        std::cout << "Couldn't save the encounter: " << error << std::endl;
+    }
+}
+
+// Replaces the board with the encounter in ENCOUNTER_FILE. The creatures
+// are only stored here; their batches are built together by the next
+// frame's CreatureLayer::update().
+void TutorialApplication::loadEncounter()
+{
+    if (!mResourcesLoaded) {
+        std::cout << "Creatures can't be placed until the resources are loaded" << std::endl;
+        return;
+    }
+
+    TraceScope scope("encounter.load");
+    EncounterFile file;
+    if (!file.open(ENCOUNTER_FILE)) {
+        std::cout << "Couldn't load the encounter: " << file.error() << std::endl;
+        return;
+    }
+
+    m_board.clear();
+    m_coverageMapDirty = true;
+    m_clipCurrent = 0;
+    m_creatures->clear();
+
+    // as when placing them by hand, the first creature in a cell keeps it
+    const GridCell *cells = file.cells();
+    const CreatureType *types = file.types();
+    std::size_t skipped = 0;
+    for (std::size_t i = 0; i < file.size(); i++) {
+        if (!m_board.addCreature(cells[i], types[i])) {
+            skipped++;
+            continue;
+        }
+        m_creatures->add(cells[i], types[i] == AllyCreature ? CreatureLayer::Ally
+                                                            : CreatureLayer::Troll);
+    }
+    m_conesDirty = true;
+
+    std::cout << "Loaded " << file.size() - skipped << " creatures from " << ENCOUNTER_FILE;
+    if (skipped) {
+        std::cout << " (" << skipped << " sharing a cell left out)";
+    }
+    std::cout << std::endl;
 }
 
 
@@ -18,35 +18,42 @@ This source file is part of the
 #define __TutorialApplication_h_
 
 #include "BaseApplication.h"
+#include "Board.h"
+#include "BoardSettings.h"
+#include "ConeCache.h"
+#include "CoverageMap.h"
+#include "CoverageOverlay.h"
+#include "CreatureLayer.h"
+#include "FloorGrid.h"
+#include "InputLog.h"
+#include <future>
+#include <memory>
 #include <vector>
 
 class TutorialApplication : public BaseApplication
 {
 public:
-    static const constexpr Ogre::Real GRID_SIZE = 100.0f;
     static const constexpr Ogre::Real GRID_SPACING = 10.0f;
+    // Chunks drawn around the centre of the view, along x and z
+    static const constexpr int VIEW_CHUNKS = 4;
+    // Cells along each side of the coverage overlay, which spans the view
+    static const constexpr int OVERLAY_CELLS = (2 * VIEW_CHUNKS + 1) * CHUNK_CELLS;
     static const constexpr Ogre::Real CURSOR_SIZE = GRID_SPACING;
-    static const constexpr Ogre::Real CONE_SIZE = 60.0f;
 
     static const constexpr auto BASE_MATERIAL = "BaseWhiteNoLighting";
-    static const std::vector<Ogre::Vector3> CONE_CASES;
 
     TutorialApplication(void);
     virtual ~TutorialApplication(void);
 
-    enum Mode {
-        NoneMode = 0,
-        TrollMode,
-        PartyMode,
-        WitchMode
-    };
-
 protected:
     virtual void chooseSceneManager() override;
     virtual void createFrameListener() override;
+    virtual bool frameRenderingQueued(const Ogre::FrameEvent &evt) override;
 
     virtual void createCamera(void) override;
     virtual void createScene(void);
+    virtual void addDetails(Ogre::StringVector &items) override;
+    virtual void updateDetails(void) override;
 
     virtual bool keyPressed(const OIS::KeyEvent &arg) override;
     virtual bool keyReleased(const OIS::KeyEvent &arg) override;
@@ -55,17 +62,89 @@ protected:
 
 private:
     Ogre::Ray getMouseRay(void);
-    void createCones(Ogre::ManualObject *obj, std::vector<Ogre::Vector3> &seen, Ogre::SceneNode *parentNode, Ogre::Vector3 pos, Ogre::Vector3 dir);
+    void updateView(void);
+    void updateCoverageMap(void);
+    void updateCursor(void);
+    void solveCones(void);
+    void saveEncounter(void);
+    void loadEncounter(void);
+    void toggleWall(void);
+    void toggleRecording(void);
+    InputEvent inputEvent(InputEventType type, std::uint32_t code = 0) const;
+    void showCones(std::uint32_t cones);
+    int coneRadius(void) const;
+    void prepareCones(void);
+    void updateConeTemplates(void);
+    bool conesReady(void) const;
+    void requestConeNodes(void);
+    void updateConeNodes(void);
+    void createConeNode(std::size_t i, const LineOfEffect *sight = nullptr);
+    void createConeMesh(Ogre::SceneNode *parentNode, const OrientedCone &cone, const Ogre::String &name,
+                        const LineOfEffect *visible);
+    void moveConeOrigin(const GridCell &origin);
+    void clipShownCones(void);
 
     Ogre::SceneNode *m_cursorNode;
     Ogre::Plane m_activeLevel;
 
     bool m_verticalMode;
-    Mode m_mode;
+    BoardMode m_mode;
 
-    std::vector<Ogre::Vector3> m_ogres;
+    // the creatures and walls, and the cone coverage from m_pointCell
+    Board m_board;
+    CreatureLayer *m_creatures;
+    FloorGrid *m_grid;
+    // most trolls a cone from each floor cell in view covers, shown by the
+    // overlay while it is on
+    CoverageOverlay *m_overlay;
+    std::unique_ptr<ConeCoverageMap> m_coverageMap;
+    bool m_coverageMapDirty;
+    bool m_hasView;
+    GridCell m_viewChunk;
+    // holds every cone size, so cycling through them never rebuilds one
+    ConeCache m_coneCache;
+    // index into CONE_RADII
+    std::size_t m_coneSize;
+    // generating the templates of radius m_futureRadius in the background
+    std::future<void> m_coneFuture;
+    int m_futureRadius;
+    // the templates of the current cone size, once they are generated
+    std::shared_ptr<const ConeSet> m_coneTemplates;
+    std::shared_ptr<const ConeSet> m_cones;
+    std::size_t m_conesBuilt;
+    bool m_conesWanted;
+    OgreBites::ProgressBar *m_coneProgress;
     Ogre::SceneNode *m_pointNode;
     std::vector<Ogre::SceneNode*> m_coneNodes;
+    // bit i is set while m_coneNodes[i] is visible
+    std::uint32_t m_shownCones;
+    // where m_pointNode is, and line of effect from there for leaving the
+    // cells behind walls out of the shown cones
+    GridCell m_coneOrigin;
+    std::unique_ptr<LineOfEffect> m_coneSight;
+    // bit i of m_clippedCones is set if cone i's mesh has cells left out,
+    // and of m_clipCurrent if it is up to date for m_coneOrigin and the
+    // walls
+    std::uint32_t m_clippedCones;
+    std::uint32_t m_clipCurrent;
+
+    // mouse picking, coalesced to once per frame
+    bool m_mouseMoved;
+    bool m_conesDirty;
+    GridCell m_cursorCell;
+    GridCell m_pointCell;
+    // the cell the pick ran into: the floor or whatever is in front of
+    // the cursor in vertical mode, the cursor cell otherwise
+    GridCell m_hitCell;
+
+    // the input while F7 recording is on
+    InputRecorder m_recorder;
+
+    // for the details panel: how long the last cone evaluation took, and
+    // the frames drawn and allocations made since it was last filled in
+    FrameTrace::Clock::duration m_coneEvalTime;
+    unsigned m_detailsFrames;
+    std::uint64_t m_detailsAllocations;
 };
 
 #endif // #ifndef __TutorialApplication_h_
@@ -0,0 +1,87 @@
+/*
+-----------------------------------------------------------------------------
+Filename:    VoxelRay.h
+-----------------------------------------------------------------------------
+*/
+#ifndef __VoxelRay_h_
+#define __VoxelRay_h_
+
+#include "GridMath.h"
+
+#include <cmath>
+#include <limits>
+
+// Where a ray stopped: the solid cell it ran into, the empty cell it was
+// in just before, and how far along the ray it entered the solid one
+struct VoxelHit
+{
+    GridCell cell;
+    GridCell before;
+    double distance;
+};
+
+// Walks a ray through every cell it crosses, in order, and stops at the
+// first one for which solid(cell) is true. Cell c spans [c, c + 1) on each
+// axis; origin and dir are in the same units, and dir need not be of unit
+// length (distance is then in multiples of it). The walk is a 3D DDA, so
+// it costs one step per cell crossed, and gives up after maxSteps cells.
+//
+// If the ray starts inside a solid cell, that cell is hit at distance 0.
+template <typename Solid>
+bool castVoxelRay(const double origin[3], const double dir[3], int maxSteps,
+                  Solid solid, VoxelHit &hit)
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    int cell[3], step[3];
+    double tMax[3], tDelta[3];
+    for (int i = 0; i < 3; i++) {
+        cell[i] = int(std::floor(origin[i]));
+        if (dir[i] > 0) {
+            step[i] = 1;
+            tDelta[i] = 1 / dir[i];
+            tMax[i] = (cell[i] + 1 - origin[i]) * tDelta[i];
+        } else if (dir[i] < 0) {
+            step[i] = -1;
+            tDelta[i] = -1 / dir[i];
+            tMax[i] = (origin[i] - cell[i]) * tDelta[i];
+        } else {
+            step[i] = 0;
+            tDelta[i] = inf;
+            tMax[i] = inf;
+        }
+    }
+
+    GridCell current(cell[0], cell[1], cell[2]);
+    if (solid(current)) {
+        hit.cell = hit.before = current;
+        hit.distance = 0;
+        return true;
+    }
+
+    for (int n = 0; n < maxSteps; n++) {
+        // cross whichever cell boundary comes first
+        int axis = tMax[0] < tMax[1] ? 0 : 1;
+        if (tMax[2] < tMax[axis]) {
+            axis = 2;
+        }
+        if (tMax[axis] == inf) {
+            break;
+        }
+
+        const double t = tMax[axis];
+        cell[axis] += step[axis];
+        tMax[axis] += tDelta[axis];
+
+        const GridCell next(cell[0], cell[1], cell[2]);
+        if (solid(next)) {
+            hit.cell = next;
+            hit.before = current;
+            hit.distance = t;
+            return true;
+        }
+        current = next;
+    }
+    return false;
+}
+
+#endif // #ifndef __VoxelRay_h_